@@ -1,14 +1,23 @@
 #ifndef AABB_TREE_H
 #define AABB_TREE_H
 
-#include <algorithm> // min, max
+#include <algorithm> // min, max, partition
+#include <limits> // numeric_limits
+#include <stdint.h>
+#include <vector>
+#include <functional> // function (test)
+#include <cstdlib> // abs (test)
 #include "utils/intpoint.h" // Point3
 
 #include "Kernel.h"
 
+#include "utils/parallel.h"
+
 
 
 #include "BoundingBox.h"
+#include "Ray.h"
+#include "utils/predicates.h" // orient3d (test)
 
 #include "MACROS.h" // debug
 
@@ -25,39 +34,307 @@
 #   define AABB_DEBUG_PRINTLN(x)
 #endif
 
+/*!
+Policy of the AABB_Tree which gives the bounding box of an object, and the squared distance from a point to an object for the proximity queries.
+The default asks the object itself.
+*/
 template<typename T>
 struct DefaultBoxer
 {
     static BoundingBox bbox(T& t) { return t.bbox(); };
+    static double squaredDistance(T& t, const Point3& p) { return t.squaredDistance(p); };
+};
+
+/*!
+Counters of the work done by queries on an AABB_Tree, to compare the query cost of trees built with different split policies.
+*/
+struct AABB_QueryStats
+{
+    long nodes_visited = 0; //!< the number of nodes of which the box has been tested (including leaves)
+    long leaves_visited = 0; //!< the number of leaves of which the box has been tested
+
+    void clear() { nodes_visited = 0; leaves_visited = 0; };
+};
+
+/*!
+The result of a closest hit ray query on an AABB_Tree.
+*/
+struct AABB_RayHit
+{
+    static const uint32_t none = std::numeric_limits<uint32_t>::max();
+    uint32_t object_idx = none; //!< the index into AABB_Tree::objects of the hit object, or \ref none
+    double t = std::numeric_limits<double>::max(); //!< the ray parameter of the hit
+
+    bool isHit() const { return object_idx != none; };
+};
+
+/*!
+The result of a proximity query on an AABB_Tree.
+*/
+struct AABB_Neighbor
+{
+    static const uint32_t none = std::numeric_limits<uint32_t>::max();
+    uint32_t object_idx = none; //!< the index into AABB_Tree::objects of the object found, or \ref none
+    double squared_distance = std::numeric_limits<double>::max(); //!< the squared distance to the object
+
+    AABB_Neighbor() {};
+    AABB_Neighbor(uint32_t object_idx, double squared_distance) : object_idx(object_idx), squared_distance(squared_distance) {};
+
+    bool isFound() const { return object_idx != none; };
+    bool operator<(const AABB_Neighbor& other) const { return squared_distance < other.squared_distance; };
+};
+
+/*!
+Split policy of the AABB_Tree: split at the median centroid, cycling through x, y and z by depth, regardless of the geometry.
+
+A split policy reorders the items in [left, right] and returns mid, such that [left, mid] and [mid+1, right] become the two children.
+It may use up to n_threads threads to do so.
+Each item has a member box: the bounding box of the object it represents.
+Ranges of at most max_leaf_size items are not split, but become a leaf.
+*/
+struct AABB_MedianSplit
+{
+    static const int max_leaf_size = 1; //!< the maximal number of objects in a leaf
+
+    template<typename Item>
+    static int split(std::vector<Item>& items, int left, int right, int depth, unsigned int)
+    {
+        int dim = depth % 3;
+        return select(items, left, right, (left + right)/2,
+                [dim](Item& n)
+                {
+                    Point mid = n.box.mid();
+                    spaceType ret = (dim==0)? mid.x : (dim==1)? mid.y : mid.z;
+                    return ret;
+                }
+            );
+    };
+
+    template<typename Item, typename GetVal>
+    static int partition(std::vector<Item>& list, int left, int right, int pivotIndex, GetVal getVal)
+    {
+        spaceType pivotValue = getVal(list[pivotIndex]);
+        std::swap(list[pivotIndex], list[right]);  // Move pivot to end
+        int storeIndex = left;
+        for (int i = left; i < right ; i++)
+        {
+            if (getVal(list[i]) < pivotValue)
+            {
+                std::swap(list[storeIndex], list[i]);
+                storeIndex++;
+            }
+        }
+        std::swap(list[right], list[storeIndex]);  // Move pivot to its final place
+        return storeIndex;
+    };
+
+    template<typename Item, typename GetVal>
+    static int select(std::vector<Item>& list, int left, int right, int n, GetVal getVal)
+    {
+         if (left == right)
+             return left;
+         while (true)
+         {
+             int pivotIndex = (right+left)/2;     // select pivotIndex between left and right
+             pivotIndex = partition(list, left, right, pivotIndex, getVal);
+             AABB_DEBUG_PRINTLN(" left = " << left << " right = " << right << " pivotIndex = " << pivotIndex <<"\t, \tn = " << n);
+
+             if (n == pivotIndex)       return n;
+             else if (n < pivotIndex)   right = pivotIndex - 1;
+             else                       left = pivotIndex + 1;
+        }
+    };
+};
+
+/*!
+Split policy of the AABB_Tree: binned surface area heuristic (SAH).
+
+The centroids are binned along each axis, and the split between two bins which minimizes
+    area(left box) * #left + area(right box) * #right
+over all axes is chosen. This is proportional to the expected cost of a query, when query boxes are small and uniformly distributed.
+In contrast to the median split, this avoids heavily overlapping children for thin-walled and elongated parts, at the cost of a possibly unbalanced tree.
+
+When all centroids coincide no such split exists, and the items are simply split in half.
+
+For large ranges the binning and partitioning is spread over \p n_threads threads.
+The partition is stable, so that the resulting tree doesn't depend on the number of threads.
+*/
+struct AABB_SAHSplit
+{
+    static const int bin_count = 16; //!< the number of bins per axis
+    static const int max_leaf_size = 4; //!< the maximal number of objects in a leaf
+
+    template<typename Item>
+    static int split(std::vector<Item>& items, int left, int right, int /*depth*/, unsigned int n_threads)
+    {
+        size_t n = right - left + 1;
+        unsigned int n_ranges = (n < parallel_threshold)? 1 : n_threads;
+
+        std::vector<BoundingBox> range_centroid_bounds(n_ranges);
+        parallelForRanges(n, n_ranges, [&](unsigned int r, size_t begin, size_t end)
+            {
+                BoundingBox bounds(items[left + begin].box.mid(), items[left + begin].box.mid());
+                for (size_t i = left + begin + 1; i < left + end; i++)
+                {
+                    bounds += items[i].box.mid();
+                }
+                range_centroid_bounds[r] = bounds;
+            }, 1);
+        BoundingBox centroid_bounds = range_centroid_bounds[0];
+        for (unsigned int r = 1; r < n_ranges; r++)
+        {
+            centroid_bounds = BoundingBox(centroid_bounds, range_centroid_bounds[r]);
+        }
+
+        std::vector<Bins> range_bins(n_ranges);
+        parallelForRanges(n, n_ranges, [&](unsigned int r, size_t begin, size_t end)
+            {
+                range_bins[r].add(items, left + begin, left + end, centroid_bounds);
+            }, 1);
+        Bins& bins = range_bins[0];
+        for (unsigned int r = 1; r < n_ranges; r++)
+        {
+            bins.add(range_bins[r]);
+        }
+
+        double best_cost = std::numeric_limits<double>::max();
+        int best_dim = -1;
+        int best_bin = -1; // the last bin of the left child
+        for (int dim = 0; dim < 3; dim++)
+        {
+            if (coord(centroid_bounds.max, dim) == coord(centroid_bounds.min, dim)) continue;
+
+            Bin* dim_bins = bins.bins[dim];
+
+            double right_costs[bin_count]; // the cost of the right child when splitting before bin b
+            BoundingBox right_box;
+            int right_count = 0;
+            for (int b = bin_count - 1; b > 0; b--)
+            {
+                if (dim_bins[b].count > 0)
+                {
+                    right_box = (right_count == 0)? dim_bins[b].box : BoundingBox(right_box, dim_bins[b].box);
+                    right_count += dim_bins[b].count;
+                }
+                right_costs[b] = (right_count == 0)? -1 : halfArea(right_box) * right_count;
+            }
+
+            BoundingBox left_box;
+            int left_count = 0;
+            for (int b = 0; b < bin_count - 1; b++)
+            {
+                if (dim_bins[b].count > 0)
+                {
+                    left_box = (left_count == 0)? dim_bins[b].box : BoundingBox(left_box, dim_bins[b].box);
+                    left_count += dim_bins[b].count;
+                }
+                if (left_count == 0 || right_costs[b + 1] < 0) continue;
+                double cost = halfArea(left_box) * left_count + right_costs[b + 1];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_dim = dim;
+                    best_bin = b;
+                }
+            }
+        }
+
+        if (best_dim < 0) return (left + right) / 2; // all centroids coincide
+
+        spaceType min = coord(centroid_bounds.min, best_dim);
+        spaceType extent = coord(centroid_bounds.max, best_dim) - min;
+        typename std::vector<Item>::iterator mid = parallelStablePartition(items.begin() + left, items.begin() + right + 1,
+            [best_dim, best_bin, min, extent](const Item& n) { return binIndex(coord(n.box.mid(), best_dim), min, extent) <= best_bin; }
+            , n_ranges, parallel_threshold / 2);
+        return (mid - items.begin()) - 1;
+    };
+
+private:
+    static const size_t parallel_threshold = 1 << 16; //!< the minimal number of items for which to bin and partition on multiple threads
+
+    struct Bin
+    {
+        BoundingBox box;
+        int count = 0;
+    };
+
+    //! The bins of all three axes
+    struct Bins
+    {
+        Bin bins[3][bin_count];
+
+        template<typename Item>
+        void add(const std::vector<Item>& items, size_t begin, size_t end, const BoundingBox& centroid_bounds)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                Point mid = items[i].box.mid();
+                for (int dim = 0; dim < 3; dim++)
+                {
+                    spaceType min = coord(centroid_bounds.min, dim);
+                    spaceType extent = coord(centroid_bounds.max, dim) - min;
+                    Bin& bin = bins[dim][binIndex(coord(mid, dim), min, extent)];
+                    bin.box = (bin.count == 0)? items[i].box : BoundingBox(bin.box, items[i].box);
+                    bin.count++;
+                }
+            }
+        };
+
+        void add(const Bins& other)
+        {
+            for (int dim = 0; dim < 3; dim++)
+            {
+                for (int b = 0; b < bin_count; b++)
+                {
+                    const Bin& other_bin = other.bins[dim][b];
+                    if (other_bin.count == 0) continue;
+                    Bin& bin = bins[dim][b];
+                    bin.box = (bin.count == 0)? other_bin.box : BoundingBox(bin.box, other_bin.box);
+                    bin.count += other_bin.count;
+                }
+            }
+        };
+    };
+
+    static spaceType coord(const Point& p, int dim) { return (dim==0)? p.x : (dim==1)? p.y : p.z; };
+    static int binIndex(spaceType c, spaceType min, spaceType extent) { return int(int64_t(c - min) * bin_count / (int64_t(extent) + 1)); };
+    static double halfArea(const BoundingBox& b)
+    {
+        Point size = b.size();
+        return double(size.x) * size.y + double(size.y) * size.z + double(size.z) * size.x;
+    };
 };
 
 /*!
 Axis Aligned Bounding Box search tree.
+
+The tree is stored in a single array of 32-byte nodes in depth-first order: the left child of an inner node directly follows it, and the node stores the index of its right child.
+A leaf refers to a range of the objects, which the tree stores (copies of) in the order of the leaves, together with their bounding boxes.
+No memory is allocated per node.
+
+The tree is constructed on all hardware threads: the bounding boxes of the objects are computed in parallel, and the children of large subtrees are constructed concurrently.
+
 @param T the type of object to be stored with/in the bounding boxes of leaves.
+@param Boxer policy which gives the bounding box of an object (see DefaultBoxer).
+@param SplitPolicy policy which determines how to split the objects over the two children of a node (AABB_MedianSplit or AABB_SAHSplit).
 */
-template<typename T, typename Boxer = DefaultBoxer<T>>
+template<typename T, typename Boxer = DefaultBoxer<T>, typename SplitPolicy = AABB_MedianSplit>
 class AABB_Tree
 {
 public:
 
     static void test()
     {
-        typedef AABB_Tree<int>::Node Node;
-        std::vector<Node*> leaves;
+        struct IntBoxer
+        {
+            static BoundingBox bbox(int& i) { return BoundingBox(Point(i,i,i), Point3(i+1,i+1,i+1)); };
+        };
 
-        int ints[9] = {0,1,2,3,4,5,6,7,8};
+        std::vector<int> ints = {8,7,6,5,4,3,2,1,0};
 
-        for (int i = 0 ; i < 9 ; i++)
-        {
-            Point p_a(i,i,i);
-            Point3 p_b(i+1,i+1,i+1);
-            leaves.push_back(new Node(BoundingBox(p_a, p_b),&ints[i]));
-        }
         std::cerr << " TEST building AABB_Tree... " << std::endl;
 
-        std::reverse(leaves.begin(), leaves.end());
-
-        AABB_Tree<int> tree(leaves);
+        AABB_Tree<int, IntBoxer> tree(ints.begin(), ints.end());
 
         tree.debugPrint();
 
@@ -67,39 +344,388 @@ public:
         Point p_a(2,3,4);
         Point3 p_b(5,6,7);
         BoundingBox bbox(p_a, p_b);
-        tree.getIntersections(bbox, intersections);
+        AABB_QueryStats stats;
+        tree.getIntersections(bbox, intersections, &stats);
 
         for (int i : intersections)
             std::cerr << i << " ";
         std::cerr << std::endl;
+        std::cerr << " visited " << stats.nodes_visited << " nodes, of which " << stats.leaves_visited << " leaves" << std::endl;
 
+        testAgainstBruteForce();
+    }
+
+    /*!
+    Compare all queries to brute force on a tree of scattered boxes, after construction, after moving some of the boxes and calling refit(),
+    and after rebuildDegraded(); also checks the links between the nodes after each step.
+    */
+    static void testAgainstBruteForce()
+    {
+        struct ScatterBoxer
+        {
+            static BoundingBox bbox(int& i)
+            {
+                Point3 p(int64_t(i) * 7919 % 100000, int64_t(i) * 104729 % 100000, int64_t(i) * 1299709 % 100000);
+                return BoundingBox(p, p + Point3(1000, 1000, 1000));
+            };
+            static double squaredDistance(int& i, const Point3& p) { return bbox(i).squaredDistance(p); };
+            //! each object is also a triangle within its box, for the ray queries
+            static bool intersect(const int& i, const Ray& ray, double t_max, double& t)
+            {
+                int object = i;
+                Point3 a = bbox(object).min;
+                return ray.intersects(a, a + Point3(1000, 1000, 0), a + Point3(0, 1000, 1000), t_max, t);
+            };
+        };
+        typedef AABB_Tree<int, ScatterBoxer, AABB_SAHSplit> Tree;
+
+        int errors = 0;
+        int n_ray_hits = 0;
+        auto check = [&errors](bool ok, const char* what)
+        {
+            if (!ok && errors++ < 10)
+                std::cerr << " FAILED: " << what << std::endl;
+        };
+        auto contains = [](const BoundingBox& outer, const BoundingBox& inner)
+        {
+            return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+                && outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+        };
+
+        // the nodes should be in depth-first order, the leaves should cover the objects in order, and each box should contain those below it
+        auto checkStructure = [&](Tree& tree)
+        {
+            check(tree.object_boxes.size() == tree.objects.size(), "an object box per object");
+            check(tree.node_build_areas.size() == tree.nodes.size(), "a build area per node");
+            for (size_t o = 0; o < tree.objects.size(); o++)
+            {
+                BoundingBox box = ScatterBoxer::bbox(tree.objects[o]);
+                check(box.min == tree.object_boxes[o].min && box.max == tree.object_boxes[o].max, "object box up to date");
+            }
+            uint32_t next_node = 0;
+            uint32_t next_object = 0;
+            std::function<void (uint32_t, int)> visit = [&](uint32_t node_idx, int node_depth)
+            {
+                check(node_idx == next_node++, "nodes in depth-first order");
+                check(node_depth <= tree.depth, "depth of the tree");
+                const typename Tree::Node& node = tree.nodes[node_idx];
+                if (node.isLeaf())
+                {
+                    check(node.index == next_object, "leaves cover the objects in order");
+                    next_object += node.count;
+                    for (uint32_t o = node.index; o < node.index + node.count && o < tree.objects.size(); o++)
+                        check(contains(node.box, tree.object_boxes[o]), "leaf box contains its objects");
+                    return;
+                }
+                check(contains(node.box, tree.nodes[node_idx + 1].box), "box contains left child");
+                visit(node_idx + 1, node_depth + 1);
+                check(node.index == next_node, "right child follows the left subtree");
+                check(node.index < tree.nodes.size() && contains(node.box, tree.nodes[node.index].box), "box contains right child");
+                if (node.index < tree.nodes.size())
+                    visit(node.index, node_depth + 1);
+            };
+            if (tree.nodes.size() > 0) visit(0, 0);
+            check(next_node == tree.nodes.size(), "all nodes reachable");
+            check(next_object == tree.objects.size(), "all objects in a leaf");
+        };
+
+        auto checkQueries = [&](Tree& tree)
+        {
+            for (int q = 0; q < 20; q++)
+            {
+                int32_t x = q * 4999 % 100000, y = q * 7717 % 100000, z = q * 3331 % 100000;
+                int32_t r = 1000 + q * 1000;
+                BoundingBox query(Point3(x, y, z), Point3(x + r, y + r, z + r));
+                std::vector<int> found;
+                tree.getIntersections(query, found);
+                std::vector<int> expected;
+                for (int& i : tree.objects)
+                    if (ScatterBoxer::bbox(i).intersectsWith(query)) expected.push_back(i);
+                std::sort(found.begin(), found.end());
+                std::sort(expected.begin(), expected.end());
+                check(found == expected, "getIntersections");
+
+                Point3 p(x, y, z);
+                std::vector<double> distances; // of all objects, ascending
+                for (int& i : tree.objects)
+                    distances.push_back(ScatterBoxer::squaredDistance(i, p));
+                std::sort(distances.begin(), distances.end());
+
+                AABB_Neighbor nearest = tree.nearest(p);
+                check(nearest.isFound() == (distances.size() > 0), "nearest found");
+                if (nearest.isFound())
+                {
+                    check(nearest.squared_distance == distances[0], "nearest distance");
+                    check(ScatterBoxer::squaredDistance(tree.objects[nearest.object_idx], p) == nearest.squared_distance, "nearest object");
+                }
+
+                unsigned int ks[3] = { 1, 7, static_cast<unsigned int>(tree.objects.size() + 10) }; // also more than there are objects
+                for (unsigned int k : ks)
+                {
+                    std::vector<AABB_Neighbor> neighbors;
+                    tree.kNearest(p, k, neighbors);
+                    check(neighbors.size() == std::min<size_t>(k, distances.size()), "kNearest count");
+                    for (size_t n = 0; n < neighbors.size() && n < distances.size(); n++)
+                    {
+                        check(neighbors[n].squared_distance == distances[n], "kNearest distances, nearest first");
+                        check(ScatterBoxer::squaredDistance(tree.objects[neighbors[n].object_idx], p) == neighbors[n].squared_distance, "kNearest object");
+                    }
+                }
+
+                double radius = 5000 + q * 500;
+                std::vector<AABB_Neighbor> within;
+                tree.withinRadius(p, radius, within);
+                std::vector<uint32_t> within_idx;
+                for (AABB_Neighbor& n : within)
+                    within_idx.push_back(n.object_idx);
+                std::sort(within_idx.begin(), within_idx.end());
+                std::vector<uint32_t> expected_idx;
+                for (uint32_t o = 0; o < tree.objects.size(); o++)
+                    if (ScatterBoxer::squaredDistance(tree.objects[o], p) <= radius * radius) expected_idx.push_back(o);
+                check(within_idx == expected_idx, "withinRadius");
+            }
+
+            // coherent rays straight down, and scattered rays each aimed at a triangle
+            std::vector<Ray> rays;
+            for (int r = 0; r < 61; r++) // not a multiple of the packet size
+            {
+                if (r < 30)
+                {
+                    rays.emplace_back(Point3(50000 + r * 300, 50000 + r * 170, 120000), Point3(0, 0, -150000));
+                    continue;
+                }
+                Point3 origin(r * 4999 % 120000 - 10000, r * 7717 % 120000 - 10000, r * 3331 % 120000 - 10000);
+                int target = r * 97;
+                rays.emplace_back(origin, ScatterBoxer::bbox(target).min + Point3(333, 667, 333) - origin); // the middle of the triangle is hit at t = 1
+            }
+            double t_maxes[2] = { 1.5, 0.5 }; // the second ends before the aimed at triangles
+            for (double t_max : t_maxes)
+            {
+                std::vector<AABB_RayHit> hits;
+                tree.closestHits(rays, t_max, ScatterBoxer::intersect, hits);
+                check(hits.size() == rays.size(), "closestHits count");
+                for (size_t r = 0; r < rays.size() && r < hits.size(); r++)
+                {
+                    const Ray& ray = rays[r];
+                    bool expected_hit = false;
+                    double expected_t = t_max;
+                    for (int& i : tree.objects)
+                    {
+                        double t;
+                        if (ScatterBoxer::intersect(i, ray, t_max, t))
+                        {
+                            expected_hit = true;
+                            expected_t = std::min(expected_t, t);
+                        }
+                    }
+                    check(tree.anyHit(ray, t_max, ScatterBoxer::intersect) == expected_hit, "anyHit");
+
+                    AABB_RayHit hit = tree.closestHit(ray, t_max, ScatterBoxer::intersect);
+                    AABB_RayHit hit_of_packet = hits[r];
+                    AABB_RayHit both[2] = { hit, hit_of_packet };
+                    for (AABB_RayHit& h : both)
+                    {
+                        check(h.isHit() == expected_hit, "closestHit(s) found");
+                        check(h.t == expected_t, "closestHit(s) t");
+                        double t;
+                        check(!h.isHit() || (ScatterBoxer::intersect(tree.objects[h.object_idx], ray, t_max, t) && t == h.t), "closestHit(s) object");
+                    }
+                    n_ray_hits += expected_hit;
+                }
+            }
+        };
+
+        // a tree of larger boxes elsewhere, split differently, to find the overlapping pairs with
+        struct LargeBoxer
+        {
+            static BoundingBox bbox(int& i)
+            {
+                Point3 p(int64_t(i) * 15485863 % 100000, int64_t(i) * 32452843 % 100000, int64_t(i) * 49979687 % 100000);
+                return BoundingBox(p, p + Point3(5000, 5000, 5000));
+            };
+        };
+        typedef AABB_Tree<int, LargeBoxer> OtherTree;
+        std::vector<int> other_ints;
+        for (int i = 0; i < 3000; i++)
+            other_ints.push_back(i);
+        OtherTree other(other_ints.begin(), other_ints.end());
+        size_t n_pairs = 0;
+
+        // the pairs should be those of a double loop, in the same order for any number of threads, and the same from both sides
+        auto checkPairs = [&](Tree& tree)
+        {
+            std::vector<std::pair<uint32_t, uint32_t>> expected;
+            for (uint32_t o = 0; o < tree.objects.size(); o++)
+            {
+                for (uint32_t other_o = 0; other_o < other.objects.size(); other_o++)
+                {
+                    if (ScatterBoxer::bbox(tree.objects[o]).intersectsWith(LargeBoxer::bbox(other.objects[other_o])))
+                        expected.emplace_back(o, other_o);
+                }
+            }
+            n_pairs += expected.size();
+
+            std::vector<std::pair<uint32_t, uint32_t>> pairs;
+            tree.getOverlappingPairs(other, pairs);
+            std::vector<std::pair<uint32_t, uint32_t>> sorted = pairs;
+            std::sort(sorted.begin(), sorted.end());
+            check(sorted == expected, "getOverlappingPairs");
+
+            unsigned int thread_counts[4] = { 1, 2, 3, 64 };
+            for (unsigned int n_threads : thread_counts)
+            {
+                std::vector<std::pair<uint32_t, uint32_t>> pairs_with_n_threads;
+                tree.getOverlappingPairs(other, pairs_with_n_threads, nullptr, n_threads);
+                check(pairs_with_n_threads == pairs, "getOverlappingPairs in the same order for any number of threads");
+            }
+
+            std::vector<std::pair<uint32_t, uint32_t>> converse;
+            other.getOverlappingPairs(tree, converse);
+            for (std::pair<uint32_t, uint32_t>& pair : converse)
+                std::swap(pair.first, pair.second);
+            std::sort(converse.begin(), converse.end());
+            check(converse == expected, "getOverlappingPairs from the other tree");
+        };
+
+        std::cerr << " TEST AABB_Tree against brute force... " << std::endl;
+
+        testRay(check);
+
+        std::vector<int> ints;
+        for (int i = 0; i < 5000; i++) // enough to construct subtrees in parallel
+            ints.push_back(i);
+        Tree tree(ints.begin(), ints.end());
+        checkStructure(tree);
+        checkQueries(tree);
+        checkPairs(tree);
+
+        Tree empty(ints.begin(), ints.begin());
+        checkStructure(empty);
+        checkQueries(empty);
+        checkPairs(empty);
+
+        // move a third of the boxes to other places
+        for (size_t o = 0; o < tree.objects.size(); o += 3)
+            tree.objects[o] += 100003;
+        tree.refit();
+        checkStructure(tree);
+        checkQueries(tree);
+        checkPairs(tree);
+
+        int n_rebuilt = tree.rebuildDegraded();
+        check(n_rebuilt > 0, "rebuildDegraded finds degraded subtrees");
+        checkStructure(tree);
+        checkQueries(tree);
+        checkPairs(tree);
+        check(tree.rebuildDegraded() == 0, "nothing degraded right after rebuildDegraded");
+
+        std::cerr << " rebuilt " << n_rebuilt << " subtrees; " << n_ray_hits << " rays hit; " << n_pairs << " overlapping pairs; " << ((errors == 0)? "all queries match brute force" : "ERRORS!") << std::endl;
+    }
+
+    /*!
+    Compare the slab test and the triangle test of Ray to exact tests on the segment from the origin of the ray to its end at t_max:
+    a separating axis test in integers for boxes, and the orientation predicates for triangles.
+    */
+    template<typename Check>
+    static void testRay(Check& check)
+    {
+        auto hashed = [](int64_t i, int64_t prime) { return int32_t(i * prime % 100000); };
+        for (int r = 0; r < 10000; r++)
+        {
+            Point3 origin(hashed(r, 7919), hashed(r, 104729), hashed(r, 1299709));
+            Point3 a(hashed(r, 15485863), hashed(r, 32452843), hashed(r, 49979687));
+            Point3 b = a + Point3(hashed(r, 67867967) / 4, hashed(r, 86028121) / 4, hashed(r, 104395301) / 4 - 12500);
+            Point3 c = a + Point3(hashed(r, 122949823) / 4 - 12500, hashed(r, 141650939) / 4 - 12500, hashed(r, 160481183) / 4);
+            // a point in the plane of the triangle, which lies inside the triangle for about half of the rays
+            double u = hashed(r, 179424673) / 100000. * 1.4 - .2;
+            double v = hashed(r, 198491317) / 100000. * (1.2 - u) - .2;
+            Point3 target = a + Point3(lround((b.x - a.x) * u + (c.x - a.x) * v), lround((b.y - a.y) * u + (c.y - a.y) * v), lround((b.z - a.z) * u + (c.z - a.z) * v));
+            if (r % 5 == 0) target.y = origin.y; // also rays parallel to a slab
+            Ray ray(origin, target - origin);
+            Point3 end = target + (target - origin); // the ray at t = 2
+
+            BoundingBox box(a, b);
+            double t_entry = -1;
+            bool hits_box = ray.intersects(box, 2, t_entry);
+            { // separating axis test of the segment from origin to end, in doubled coordinates so that everything stays integer
+                int64_t m[3] = { int64_t(origin.x) + end.x - box.min.x - box.max.x, int64_t(origin.y) + end.y - box.min.y - box.max.y, int64_t(origin.z) + end.z - box.min.z - box.max.z };
+                int64_t d[3] = { int64_t(end.x) - origin.x, int64_t(end.y) - origin.y, int64_t(end.z) - origin.z };
+                int64_t e[3] = { int64_t(box.max.x) - box.min.x, int64_t(box.max.y) - box.min.y, int64_t(box.max.z) - box.min.z };
+                bool separated = false;
+                for (int dim = 0; dim < 3; dim++)
+                {
+                    int d1 = (dim + 1) % 3, d2 = (dim + 2) % 3;
+                    separated |= std::abs(m[dim]) > e[dim] + std::abs(d[dim]);
+                    separated |= std::abs(m[d1] * d[d2] - m[d2] * d[d1]) > e[d1] * std::abs(d[d2]) + e[d2] * std::abs(d[d1]);
+                }
+                check(hits_box == !separated, "Ray::intersects box");
+            }
+            if (hits_box)
+            {
+                BoundingBox around(box.min - Point3(1, 1, 1), box.max + Point3(1, 1, 1));
+                check(t_entry >= 0 && t_entry <= 2 && around.squaredDistance(ray.at(t_entry)) == 0, "Ray::intersects box entry");
+            }
+
+            int end_side = orient3d(a, b, c, end);
+            int origin_side = orient3d(a, b, c, origin);
+            int edge_sides[3] = { orient3d(origin, end, a, b), orient3d(origin, end, b, c), orient3d(origin, end, c, a) };
+            if (end_side == 0 || origin_side == 0 || edge_sides[0] == 0 || edge_sides[1] == 0 || edge_sides[2] == 0) continue; // touching; too close to call in doubles
+            bool crosses = end_side != origin_side && edge_sides[0] == edge_sides[1] && edge_sides[1] == edge_sides[2];
+            double t = -1;
+            check(ray.intersects(a, b, c, 2, t) == crosses, "Ray::intersects triangle");
+            if (crosses)
+            {
+                BoundingBox around(BoundingBox(a, b) + c);
+                around.min -= Point3(1, 1, 1);
+                around.max += Point3(1, 1, 1);
+                check(t >= 0 && t <= 2 && around.squaredDistance(ray.at(t)) == 0, "Ray::intersects triangle at t");
+                if (r % 5 != 0) check(!ray.intersects(a, b, c, .5, t), "Ray::intersects triangle beyond t_max"); // the triangle is hit at about t = 1
+            }
+        }
     }
 
     struct Node
     {
         BoundingBox box;
-        T* object; // null pointer if Fork-Node
+        uint32_t index; //!< for an inner node the index of the right child, for a leaf the index of its first object
+        uint32_t count; //!< the number of objects in a leaf; zero for inner nodes
 
-        Node(BoundingBox b, T* o) : box(b), object(o) {};
-        int pos; //!< position in the list allnodes
-    protected:
+        bool isLeaf() const { return count > 0; };
     };
+    static_assert(sizeof(Node) == 32, "AABB_Tree nodes should fit twice in a cache line");
 
-    std::vector<Node*> allnodes; //!< allNodes[i].childA = allnodes[2*i+1] ; allNodes[i].childB = allnodes[2*i+2] ; allNodes[i].parent = allNodes[(i-1)/2]
+    std::vector<Node> nodes; //!< all nodes of the tree, in depth-first order; the root is the first node
+    std::vector<T> objects; //!< all objects, in the order of the leaves
+    std::vector<BoundingBox> object_boxes; //!< the bounding box of each object in \ref objects
+    std::vector<float> node_build_areas; //!< the surface area of the box of each node when it was constructed, to measure how much it degraded by refits
     int depth; //!< the depth of the tree
 
 private:
-    template<typename iterator>
-//    typename enable_if<
-//        is_same<typename iterator_traits<I>::value_type, T>
-//        >:type
-    static std::vector<Node*> objects2nodes(iterator begin, iterator end)
+    /*!
+    Below this depth the split policy is used; deeper nodes are split at the median, which bounds the depth of the tree to max_policy_depth + log2(#objects).
+    */
+    static const int max_policy_depth = 64;
+    static const int max_stack_size = 128; //!< the maximal depth of the tree, which is the number of nodes on the traversal stack
+
+    static const size_t parallel_subtree_threshold = 4096; //!< the minimal number of objects of a subtree for which to construct its children in parallel
+
+    static const int ray_packet_size = 8; //!< the number of rays traversing the tree together in closestHits
+
+    struct BuildItem
     {
-        std::vector<Node*> leaves;
-        for (iterator it = begin; it != end; it++)
-            leaves.push_back(new Node(Boxer::bbox(*it), &*it));
-        return leaves;
+        BoundingBox box;
+        uint32_t object_idx; //!< index into the range the tree is constructed from
+    };
+
+    //! The output of the construction of (a part of) the tree
+    struct Subtree
+    {
+        std::vector<Node> nodes;
+        std::vector<T> objects;
+        std::vector<BoundingBox> object_boxes;
+        int depth = 0;
     };
+
 public:
 
     template<typename iterator>
@@ -107,228 +733,790 @@ public:
 //        is_same<typename iterator_traits<I>::value_type, T>
 //        >:type
     AABB_Tree(iterator begin, iterator end)
-    : AABB_Tree(objects2nodes(begin, end))
-    { };
-
-private:
-    AABB_Tree(std::vector<Node*> objects)
+    : depth(0)
     {
-        if (objects.size() == 0) return;
+        std::vector<T> input(begin, end);
+        if (input.size() == 0) return;
 
-        long leavesSize = 1;
-        long totalSize = 1;
-        depth = 0;
-        while (leavesSize < objects.size())
-        {
-            leavesSize *= 2;
-            totalSize += leavesSize;
-            depth++;
-        }
-
-        allnodes.resize(totalSize, nullptr);
+        std::vector<BuildItem> items(input.size());
+        parallelFor(input.size(), [&input, &items](size_t i)
+            {
+                items[i].box = Boxer::bbox(input[i]);
+                items[i].object_idx = i;
+            });
 
-//        std::cerr << "treeSize = " << leavesSize << std::endl;
-//        std::cerr << "tree_list_pos , dim , left , right , depth " << std::endl;
+        Subtree tree;
+        tree.nodes.reserve(input.size() * 2 - 1);
+        tree.objects.reserve(input.size());
+        tree.object_boxes.reserve(input.size());
 
-        construct(objects, 0, 0, 0, objects.size()-1);
+        construct(input, items, 0, 0, items.size()-1, tree, getThreadCount());
 
+        nodes.swap(tree.nodes);
+        objects.swap(tree.objects);
+        object_boxes.swap(tree.object_boxes);
+        depth = tree.depth;
 
-    };
-public:
-    ~AABB_Tree()
-    {
-        allnodes.clear();
+        node_build_areas.resize(nodes.size());
+        parallelFor(nodes.size(), [this](size_t n) { node_build_areas[n] = halfArea(nodes[n].box); });
     };
 
-    void debugPrint()
-    {
-
-        AABB_DEBUG_PRINTLN("  allnodes.size()  = " <<  allnodes.size() );
+    /*!
+    Update the bounding boxes of all objects and nodes after the objects have moved, keeping the structure of the tree.
 
-        int width = 1;
-        int last_depth = 0;
-        int d = 0;
-        for (int i = 0 ; i < allnodes.size() ; i++)
+    This is linear in the size of the tree, instead of the n log n of constructing a new tree,
+    but the tree may become less efficient when the objects moved relative to each other; see rebuildDegraded.
+    */
+    void refit()
+    {
+        parallelFor(objects.size(), [this](size_t o)
+            {
+                object_boxes[o] = Boxer::bbox(objects[o]);
+            });
+        // the children of a node come after it in the node array
+        for (size_t node_idx = nodes.size(); node_idx-- > 0; )
         {
-            if (allnodes[i] == nullptr)
+            Node& node = nodes[node_idx];
+            if (node.isLeaf())
             {
-                std::cerr << "  _  " ;
-                continue;
+                BoundingBox box = object_boxes[node.index];
+                for (uint32_t o = node.index + 1; o < node.index + node.count; o++)
+                {
+                    box = BoundingBox(box, object_boxes[o]);
+                }
+                node.box = box;
             }
-                std:: cerr << allnodes[i]->box.min <<"-"<<allnodes[i]->box.max <<"   ";
-            if (allnodes[i]->object != nullptr) std:: cerr << * allnodes[i]->object << "   ";
-
-            if (i == last_depth)
+            else
             {
-                std:: cerr << std::endl;
-                width *= 2;
-                last_depth += width;
-                d++;
+                node.box = BoundingBox(nodes[node_idx + 1].box, nodes[node.index].box);
             }
         }
+    }
+
+    /*!
+    Construct the subtrees anew which have degraded by refits, i.e. of which the objects have moved apart.
+
+    A node is degraded when the surface area of its box has grown by more than a factor \p max_growth since it was constructed.
+    The subtrees of the highest degraded nodes are constructed anew from their objects.
+    \return the number of subtrees constructed anew
+    */
+    int rebuildDegraded(double max_growth = 2.0)
+    {
+        std::vector<std::pair<uint32_t, int>> degraded; // the highest degraded nodes with their depth, in depth-first order
+        if (nodes.size() > 0) findDegraded(0, 0, max_growth, degraded);
+
+        // rebuild from the back, so that the indices of the degraded nodes which are yet to be rebuilt remain valid
+        for (size_t d = degraded.size(); d-- > 0; )
+        {
+            rebuildSubtree(degraded[d].first, degraded[d].second);
+        }
+        return degraded.size();
+    }
+
+    void debugPrint()
+    {
+
+        AABB_DEBUG_PRINTLN("  nodes.size()  = " <<  nodes.size() );
+
+        if (nodes.size() > 0) debugPrint(0, 0);
 
         std:: cerr << std::endl;
     }
 
 protected:
-    Node* construct(std::vector<Node*>& objects, int tree_list_pos, int dim, int left, int right)
+    void debugPrint(uint32_t node_idx, int node_depth)
     {
-            AABB_DEBUG_PRINTLN(tree_list_pos << ", " << dim << ", " << left << ", " << right);
-            AABB_DEBUG_DO(
-                for (int i = 0 ; i < objects.size() ; i++)
-                {
-                    if (i == left) std::cerr << ">";
-                    std::cerr << * objects[i]->object;
-                    if (i == right) std::cerr << "<";
+        Node& node = nodes[node_idx];
+        std::cerr << std::string(node_depth * 2, ' ') << node.box.min << "-" << node.box.max;
+        for (uint32_t o = node.index; o < node.index + node.count; o++)
+            std:: cerr << "   " << objects[o];
+        std::cerr << std::endl;
+        if (!node.isLeaf())
+        {
+            debugPrint(node_idx + 1, node_depth + 1);
+            debugPrint(node.index, node_depth + 1);
+        }
+    }
 
-                }
-                std::cerr << std::endl;
-            );
+    /*!
+    Construct the subtree for items [left, right] at the end of the node array of \p out.
 
-        if (right == left)
+    While more than one thread is available for a large subtree, its right child is constructed in a separate Subtree on a new thread,
+    which is appended to \p out afterwards. The result is the same as when constructing on a single thread.
+    \param n_threads the number of threads this subtree may use
+    \return the index of the constructed node
+    */
+    static uint32_t construct(const std::vector<T>& input, std::vector<BuildItem>& items, int node_depth, int left, int right, Subtree& out, unsigned int n_threads)
+    {
+        AABB_DEBUG_PRINTLN(node_depth << ", " << left << ", " << right);
+
+        out.depth = std::max(out.depth, node_depth);
+        uint32_t node_idx = out.nodes.size();
+        out.nodes.emplace_back();
+        if (right - left + 1 <= SplitPolicy::max_leaf_size)
         {
-            allnodes[tree_list_pos] = objects[left];
-            allnodes[tree_list_pos]->pos = tree_list_pos;
-            AABB_DEBUG_PRINTLN("inserted " << * allnodes[tree_list_pos]->object << " at position " << tree_list_pos);
-            return allnodes[tree_list_pos];
+            BoundingBox box = items[left].box;
+            for (int i = left; i <= right; i++)
+            {
+                box = BoundingBox(box, items[i].box);
+            }
+            Node& leaf = out.nodes[node_idx];
+            leaf.box = box;
+            leaf.index = out.objects.size();
+            leaf.count = right - left + 1;
+            for (int i = left; i <= right; i++)
+            {
+                out.objects.push_back(input[items[i].object_idx]);
+                out.object_boxes.push_back(items[i].box);
+            }
+            AABB_DEBUG_PRINTLN("inserted leaf with " << leaf.count << " objects at depth " << node_depth);
         } else
         {
-            int mid = select(objects, left, right, (left + right)/2,
-                    [dim](Node& n)
-                    {
-                        Point mid = n.box.mid();
-                        spaceType ret = (dim==0)? mid.x : (dim==1)? mid.y : mid.z;
-                        return ret;
-                    }
-                );
+            int mid = (node_depth < max_policy_depth)? SplitPolicy::split(items, left, right, node_depth, n_threads) : AABB_MedianSplit::split(items, left, right, node_depth, n_threads);
             AABB_DEBUG_SHOW(mid);
 
-            Node* left_node = construct(objects, tree_list_pos*2+1, (dim+1) % 3, left, mid);
-            AABB_DEBUG_PRINTLN(" right... ");
-            Node* right_node = construct(objects, tree_list_pos*2+2, (dim+1) % 3, mid+1, right);
+            uint32_t left_idx;
+            uint32_t right_idx;
+            if (n_threads > 1 && size_t(right - left + 1) >= parallel_subtree_threshold)
+            {
+                Subtree right_tree;
+                unsigned int right_threads = n_threads - n_threads / 2;
+                std::thread right_thread([&]()
+                    {
+                        construct(input, items, node_depth + 1, mid+1, right, right_tree, right_threads);
+                    });
+                left_idx = construct(input, items, node_depth + 1, left, mid, out, n_threads / 2);
+                right_thread.join();
+                right_idx = append(out, right_tree);
+            }
+            else
+            {
+                left_idx = construct(input, items, node_depth + 1, left, mid, out, n_threads);
+                AABB_DEBUG_PRINTLN(" right... ");
+                right_idx = construct(input, items, node_depth + 1, mid+1, right, out, n_threads);
+            }
+
+            Node& node = out.nodes[node_idx];
+            node.box = BoundingBox(out.nodes[left_idx].box, out.nodes[right_idx].box);
+            node.index = right_idx;
+            node.count = 0;
+        }
+        return node_idx;
+    }
 
-            allnodes[tree_list_pos] = new Node(BoundingBox(left_node->box, right_node->box), nullptr);
-            allnodes[tree_list_pos]->pos = tree_list_pos;
-            return allnodes[tree_list_pos];
+    /*!
+    Append \p subtree to \p out, offsetting its child and object indices.
+    \return the index of the root of the appended subtree
+    */
+    static uint32_t append(Subtree& out, const Subtree& subtree)
+    {
+        uint32_t node_offset = out.nodes.size();
+        uint32_t object_offset = out.objects.size();
+        for (const Node& node : subtree.nodes)
+        {
+            out.nodes.push_back(node);
+            out.nodes.back().index += (node.isLeaf())? object_offset : node_offset;
         }
+        out.objects.insert(out.objects.end(), subtree.objects.begin(), subtree.objects.end());
+        out.object_boxes.insert(out.object_boxes.end(), subtree.object_boxes.begin(), subtree.object_boxes.end());
+        out.depth = std::max(out.depth, subtree.depth);
+        return node_offset;
     }
 
 public:
     bool isLeaf(Node& p) // non-leaves must have both children!
     {
-        int pos = p.pos*2 +2; // check only if it has a right child
-        if (pos >= allnodes.size()) return true;
-        else return allnodes[pos] == nullptr;
+        return p.isLeaf();
     };
 
     Node* getRoot()
     {
-        return (allnodes.size() > 0)? allnodes[0] : nullptr;
+        return (nodes.size() > 0)? &nodes[0] : nullptr;
     };
     Node* getLeftChild(Node& p)
     {
-        int pos = p.pos*2 +1;
-        if (pos >= allnodes.size()) return nullptr;
-        else return allnodes[pos];
+        return (p.isLeaf())? nullptr : &p + 1;
     };
     Node* getRightChild(Node& p)
     {
-        int pos = p.pos*2 +2;
-        if (pos >= allnodes.size()) return nullptr;
-        else return allnodes[pos];
+        return (p.isLeaf())? nullptr : &nodes[p.index];
     };
-    Node* getParent(Node& c)
-    {
-        if (c.pos == 0) return nullptr;
-        else return allnodes[(c.pos - 1)/2];
-    }
 
-    void getIntersections(BoundingBox& bbox, std::vector<T>& result)
+    /*!
+    Get all objects of which the bounding box intersects with \p bbox.
+    \param stats if given, the visited nodes are counted in it
+    */
+    void getIntersections(BoundingBox& bbox, std::vector<T>& result, AABB_QueryStats* stats = nullptr)
     {
         AABB_DEBUG_PRINTLN("getIntersections for box " << bbox.min << " - " << bbox.max << ");");
-        getIntersections(bbox, result, getRoot());
+        forEachIntersection(bbox, stats, [&result, this](uint32_t o) { result.push_back(objects[o]); });
     }
-    void getIntersections(BoundingBox& bbox, std::vector<std::pair<BoundingBox, T>>& result)
+    void getIntersections(BoundingBox& bbox, std::vector<std::pair<BoundingBox, T>>& result, AABB_QueryStats* stats = nullptr)
     {
         AABB_DEBUG_PRINTLN("getIntersections2 for box " << bbox.min << " - " << bbox.max << ");");
-        getIntersections(bbox, result, getRoot());
+        forEachIntersection(bbox, stats, [&result, this](uint32_t o) { result.push_back(std::pair<BoundingBox, T>(object_boxes[o], objects[o])); });
     }
-protected:
-    void getIntersections(BoundingBox& bbox, std::vector<T>& result, Node* node)
+
+    /*!
+    Whether \p ray hits any object for a t in [0, \p t_max].
+    \param intersect the ray-object test: bool intersect(const T& object, const Ray& ray, double t_max, double& t)
+    \param stats if given, the visited nodes are counted in it
+    */
+    template<typename Intersect>
+    bool anyHit(const Ray& ray, double t_max, Intersect intersect, AABB_QueryStats* stats = nullptr)
+    {
+        if (nodes.size() == 0) return false;
+
+        uint32_t stack[max_stack_size];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0)
+        {
+            uint32_t node_idx = stack[--stack_size];
+            while (true)
+            {
+                const Node& node = nodes[node_idx];
+                if (stats) stats->nodes_visited++;
+                double t_entry;
+                if (!ray.intersects(node.box, t_max, t_entry)) break;
+
+                if (node.isLeaf())
+                {
+                    if (stats) stats->leaves_visited++;
+                    for (uint32_t o = node.index; o < node.index + node.count; o++)
+                    {
+                        double t;
+                        if (intersect(objects[o], ray, t_max, t)) return true;
+                    }
+                    break;
+                }
+                stack[stack_size++] = node.index;
+                node_idx++;
+            }
+        }
+        return false;
+    }
+
+    /*!
+    Get the object which \p ray hits first, for a t in [0, \p t_max].
+
+    The children are visited nearest first, and subtrees which the ray enters after the closest hit so far are skipped.
+    \param intersect the ray-object test: bool intersect(const T& object, const Ray& ray, double t_max, double& t)
+    \param stats if given, the visited nodes are counted in it
+    */
+    template<typename Intersect>
+    AABB_RayHit closestHit(const Ray& ray, double t_max, Intersect intersect, AABB_QueryStats* stats = nullptr)
     {
-        if (node->object == nullptr && node->box.intersectsWith(bbox))
+        AABB_RayHit hit;
+        hit.t = t_max;
+        if (nodes.size() == 0) return hit;
+
+        struct StackEntry
         {
-            getIntersections(bbox, result, getLeftChild(*node));
-            getIntersections(bbox, result, getRightChild(*node));
-        } else if (node->box.intersectsWith(bbox))
+            uint32_t node_idx;
+            double t_entry;
+        };
+        StackEntry stack[max_stack_size];
+        int stack_size = 0;
+        if (stats) stats->nodes_visited++;
+        double root_entry;
+        if (!ray.intersects(nodes[0].box, hit.t, root_entry)) return hit;
+        stack[stack_size++] = StackEntry{0, root_entry};
+        while (stack_size > 0)
         {
-            AABB_DEBUG_PRINTLN("add element with box " << node->box.min << " - " << node->box.max << ");");
-            AABB_DEBUG_DO(
-                node->box.print_lines_csv(std::cerr);
-            );
+            StackEntry entry = stack[--stack_size];
+            if (entry.t_entry > hit.t) continue; // a closer hit has been found meanwhile
+            const Node& node = nodes[entry.node_idx];
+
+            if (node.isLeaf())
+            {
+                if (stats) stats->leaves_visited++;
+                for (uint32_t o = node.index; o < node.index + node.count; o++)
+                {
+                    double t;
+                    if (intersect(objects[o], ray, hit.t, t) && t <= hit.t)
+                    {
+                        hit.t = t;
+                        hit.object_idx = o;
+                    }
+                }
+                continue;
+            }
 
-            result.push_back(*node->object);
+            uint32_t left = entry.node_idx + 1;
+            uint32_t right = node.index;
+            double t_left, t_right;
+            if (stats) stats->nodes_visited += 2;
+            bool hit_left = ray.intersects(nodes[left].box, hit.t, t_left);
+            bool hit_right = ray.intersects(nodes[right].box, hit.t, t_right);
+            if (hit_left && hit_right)
+            { // push the farther child first, so that the nearer one is visited first
+                if (t_left <= t_right)
+                {
+                    stack[stack_size++] = StackEntry{right, t_right};
+                    stack[stack_size++] = StackEntry{left, t_left};
+                }
+                else
+                {
+                    stack[stack_size++] = StackEntry{left, t_left};
+                    stack[stack_size++] = StackEntry{right, t_right};
+                }
+            }
+            else if (hit_left) stack[stack_size++] = StackEntry{left, t_left};
+            else if (hit_right) stack[stack_size++] = StackEntry{right, t_right};
         }
+        return hit;
     }
-    void getIntersections(BoundingBox& bbox, std::vector<std::pair<BoundingBox, T>>& result, Node* node)
+
+    /*!
+    Get the first hit of each of \p rays, for a t in [0, \p t_max].
+
+    The rays are traversed in packets of consecutive rays, so that each node is fetched once for all rays of a packet which reach it.
+    This pays off for coherent rays, i.e. when consecutive rays have nearby origins and similar directions.
+    The packets are spread over all hardware threads.
+    \param intersect the ray-object test: bool intersect(const T& object, const Ray& ray, double t_max, double& t)
+    \param result output: the hit of each ray
+    */
+    template<typename Intersect>
+    void closestHits(const std::vector<Ray>& rays, double t_max, Intersect intersect, std::vector<AABB_RayHit>& result)
     {
-        if (node->object == nullptr && node->box.intersectsWith(bbox))
+        result.assign(rays.size(), AABB_RayHit());
+        for (AABB_RayHit& hit : result)
         {
-            getIntersections(bbox, result, getLeftChild(*node));
-            getIntersections(bbox, result, getRightChild(*node));
-        } else if (node->box.intersectsWith(bbox))
+            hit.t = t_max;
+        }
+        if (nodes.size() == 0) return;
+
+        size_t n_packets = (rays.size() + ray_packet_size - 1) / ray_packet_size;
+        parallelFor(n_packets, [&](size_t packet)
+            {
+                size_t begin = packet * ray_packet_size;
+                int packet_size = std::min(size_t(ray_packet_size), rays.size() - begin);
+                closestHits(&rays[begin], packet_size, intersect, &result[begin]);
+            }, 16);
+    }
+
+    /*!
+    Get all pairs of an object of this tree and an object of \p other of which the bounding boxes intersect.
+
+    Both trees are descended simultaneously: of each pair of intersecting nodes the larger node is opened up, until both are leaves.
+    This visits each pair of overlapping subtrees once, instead of descending \p other from its root for each object of this tree.
+
+    The top of the simultaneous descent is expanded into pairs of subtrees, which are descended on \p n_threads threads.
+    The result is in the same order regardless of the number of threads.
+    \param result output: pairs of an index into \ref objects and an index into the objects of \p other
+    \param stats if given, the visited node pairs are counted in it
+    \param n_threads the number of threads to spread the pairs of subtrees over
+    */
+    template<typename T2, typename Boxer2, typename SplitPolicy2>
+    void getOverlappingPairs(const AABB_Tree<T2, Boxer2, SplitPolicy2>& other, std::vector<std::pair<uint32_t, uint32_t>>& result, AABB_QueryStats* stats = nullptr, unsigned int n_threads = getThreadCount()) const
+    {
+        result.clear();
+        if (nodes.size() == 0 || other.nodes.size() == 0) return;
+
+        std::vector<std::pair<uint32_t, uint32_t>> tasks; // pairs of intersecting nodes
+        tasks.emplace_back(0, 0);
+        if (stats) stats->nodes_visited++;
+        if (!nodes[0].box.intersectsWith(other.nodes[0].box)) return;
+
+        // expand the pairs breadth-first until there are enough to spread over the threads
+        size_t min_tasks = n_threads * 8;
+        for (int level = 0; level < max_stack_size && tasks.size() < min_tasks; level++)
         {
-            AABB_DEBUG_PRINTLN("add element with box " << node->box.min << " - " << node->box.max << ");");
-            AABB_DEBUG_DO(
-                node->box.print_lines_csv(std::cerr);
-            );
+            std::vector<std::pair<uint32_t, uint32_t>> expanded;
+            bool expanded_any = false;
+            for (const std::pair<uint32_t, uint32_t>& task : tasks)
+            {
+                uint32_t children[2][2];
+                int n_children = openLarger(other, task.first, task.second, children);
+                expanded_any |= n_children > 1 || children[0][0] != task.first || children[0][1] != task.second;
+                for (int c = 0; c < n_children; c++)
+                {
+                    if (stats) stats->nodes_visited++;
+                    if (nodes[children[c][0]].box.intersectsWith(other.nodes[children[c][1]].box))
+                        expanded.emplace_back(children[c][0], children[c][1]);
+                }
+            }
+            tasks.swap(expanded);
+            if (!expanded_any) break;
+        }
+
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> task_results(tasks.size());
+        std::vector<AABB_QueryStats> task_stats(tasks.size());
+        parallelForRanges(tasks.size(), n_threads, [&](unsigned int, size_t begin, size_t end)
+            {
+                for (size_t t = begin; t < end; t++)
+                {
+                    getOverlappingPairs(other, tasks[t].first, tasks[t].second, task_results[t], task_stats[t]);
+                }
+            }, 1);
 
-            result.push_back(std::pair<BoundingBox, T>(node->box, *node->object));
+        size_t n_pairs = 0;
+        for (const std::vector<std::pair<uint32_t, uint32_t>>& task_result : task_results)
+        {
+            n_pairs += task_result.size();
+        }
+        result.reserve(n_pairs);
+        for (size_t t = 0; t < tasks.size(); t++)
+        {
+            result.insert(result.end(), task_results[t].begin(), task_results[t].end());
+            if (stats)
+            {
+                stats->nodes_visited += task_stats[t].nodes_visited;
+                stats->leaves_visited += task_stats[t].leaves_visited;
+            }
         }
     }
-private:
-    template<typename GetVal>
-    static int partition(std::vector<Node*>& list, int left, int right, int pivotIndex, GetVal getVal)
+
+    /*!
+    Get the object nearest to \p p, if any lies within a squared distance of \p max_squared_distance.
+    The distance to an object is given by Boxer::squaredDistance.
+    \param stats if given, the visited nodes are counted in it
+    */
+    AABB_Neighbor nearest(const Point3& p, double max_squared_distance = std::numeric_limits<double>::max(), AABB_QueryStats* stats = nullptr)
     {
-//        AABB_DEBUG_DO(std::cerr << " :: "; for (int i=0;i<list.size();i++) std::cerr << *list[i]->object; std::cerr << std::endl;)
-        spaceType pivotValue = getVal(*list[pivotIndex]);
-        std::swap(list[pivotIndex], list[right]);  // Move pivot to end
-        int storeIndex = left;
-        for (int i = left; i < right ; i++)
+        AABB_Neighbor result;
+        result.squared_distance = max_squared_distance;
+        forEachNearby(p, stats
+            , [&result]() { return result.squared_distance; }
+            , [&result](uint32_t o, double squared_distance) { result = AABB_Neighbor(o, squared_distance); });
+        return result;
+    }
+
+    /*!
+    Get the \p k objects nearest to \p p which lie within a squared distance of \p max_squared_distance.
+    The distance to an object is given by Boxer::squaredDistance.
+    \param result output: at most \p k objects, nearest first
+    \param stats if given, the visited nodes are counted in it
+    */
+    void kNearest(const Point3& p, unsigned int k, std::vector<AABB_Neighbor>& result, double max_squared_distance = std::numeric_limits<double>::max(), AABB_QueryStats* stats = nullptr)
+    {
+        result.clear();
+        if (k == 0) return;
+        // result is a max-heap, so that the farthest of the k nearest so far is at the front
+        forEachNearby(p, stats
+            , [&]() { return (result.size() < k)? max_squared_distance : result.front().squared_distance; }
+            , [&](uint32_t o, double squared_distance)
+                {
+                    if (result.size() == k)
+                    {
+                        std::pop_heap(result.begin(), result.end());
+                        result.pop_back();
+                    }
+                    result.emplace_back(o, squared_distance);
+                    std::push_heap(result.begin(), result.end());
+                });
+        std::sort_heap(result.begin(), result.end());
+    }
+
+    /*!
+    Get all objects within \p radius of \p p.
+    The distance to an object is given by Boxer::squaredDistance.
+    \param result output: the objects found, in no particular order
+    \param stats if given, the visited nodes are counted in it
+    */
+    void withinRadius(const Point3& p, double radius, std::vector<AABB_Neighbor>& result, AABB_QueryStats* stats = nullptr)
+    {
+        result.clear();
+        double max_squared_distance = radius * radius;
+        forEachNearby(p, stats
+            , [max_squared_distance]() { return max_squared_distance; }
+            , [&result](uint32_t o, double squared_distance) { result.emplace_back(o, squared_distance); });
+    }
+
+protected:
+    /*!
+    Branch and bound traversal for the proximity queries.
+
+    Calls \p handle(object_idx, squared_distance) for objects within the squared distance given by \p bound(), which the handle may decrease.
+    The children are visited nearest first, and subtrees of which the box lies beyond the bound are skipped.
+    */
+    template<typename Bound, typename Handle>
+    void forEachNearby(const Point3& p, AABB_QueryStats* stats, Bound bound, Handle handle)
+    {
+        if (nodes.size() == 0) return;
+
+        struct StackEntry
+        {
+            uint32_t node_idx;
+            double squared_distance; //!< the squared distance from p to the box of the node
+        };
+        StackEntry stack[max_stack_size];
+        int stack_size = 0;
+        if (stats) stats->nodes_visited++;
+        stack[stack_size++] = StackEntry{0, nodes[0].box.squaredDistance(p)};
+        while (stack_size > 0)
         {
-            if (getVal(*list[i]) < pivotValue)
+            StackEntry entry = stack[--stack_size];
+            if (entry.squared_distance > bound()) continue;
+            const Node& node = nodes[entry.node_idx];
+
+            if (node.isLeaf())
             {
-                std::swap(list[storeIndex], list[i]);
-                storeIndex++;
+                if (stats) stats->leaves_visited++;
+                for (uint32_t o = node.index; o < node.index + node.count; o++)
+                {
+                    if (object_boxes[o].squaredDistance(p) > bound()) continue;
+                    double squared_distance = Boxer::squaredDistance(objects[o], p);
+                    if (squared_distance <= bound()) handle(o, squared_distance);
+                }
+                continue;
+            }
+
+            uint32_t left = entry.node_idx + 1;
+            uint32_t right = node.index;
+            if (stats) stats->nodes_visited += 2;
+            double d_left = nodes[left].box.squaredDistance(p);
+            double d_right = nodes[right].box.squaredDistance(p);
+            if (d_left <= d_right)
+            { // push the farther child first, so that the nearer one is visited first
+                stack[stack_size++] = StackEntry{right, d_right};
+                stack[stack_size++] = StackEntry{left, d_left};
+            }
+            else
+            {
+                stack[stack_size++] = StackEntry{left, d_left};
+                stack[stack_size++] = StackEntry{right, d_right};
             }
-//            AABB_DEBUG_DO(std::cerr << " :: "; for (int i=0;i<list.size();i++) std::cerr << *list[i]->object; std::cerr << " : " << pivotValue << " , " << pivotIndex << std::endl;)
         }
-        std::swap(list[right], list[storeIndex]);  // Move pivot to its final place
+    }
 
-//        AABB_DEBUG_DO(std::cerr << " :: "; for (int i=0;i<list.size();i++) std::cerr << *list[i]->object; std::cerr << std::endl;)
+    /*!
+    Get the pairs of children to descend into from the pair of nodes \p node_idx of this tree and \p other_idx of \p other:
+    the larger inner node is replaced by its children. When both nodes are leaves the pair itself is returned.
+    \return the number of pairs in \p children
+    */
+    template<typename Other>
+    int openLarger(const Other& other, uint32_t node_idx, uint32_t other_idx, uint32_t children[2][2]) const
+    {
+        const Node& node = nodes[node_idx];
+        const typename Other::Node& other_node = other.nodes[other_idx];
+        bool open_this = !node.isLeaf() && (other_node.isLeaf() || halfArea(node.box) >= halfArea(other_node.box));
+        if (open_this)
+        {
+            children[0][0] = node_idx + 1; children[0][1] = other_idx;
+            children[1][0] = node.index; children[1][1] = other_idx;
+            return 2;
+        }
+        if (!other_node.isLeaf())
+        {
+            children[0][0] = node_idx; children[0][1] = other_idx + 1;
+            children[1][0] = node_idx; children[1][1] = other_node.index;
+            return 2;
+        }
+        children[0][0] = node_idx; children[0][1] = other_idx;
+        return 1;
+    }
 
-        return storeIndex;
+    /*!
+    Descend the intersecting nodes \p node_idx of this tree and \p other_idx of \p other simultaneously, using an explicit stack.
+    */
+    template<typename Other>
+    void getOverlappingPairs(const Other& other, uint32_t node_idx, uint32_t other_idx, std::vector<std::pair<uint32_t, uint32_t>>& result, AABB_QueryStats& stats) const
+    {
+        std::pair<uint32_t, uint32_t> stack[2 * max_stack_size]; // the depth of the descent is at most the sum of the depths of both trees
+        int stack_size = 0;
+        stack[stack_size++] = std::make_pair(node_idx, other_idx);
+        while (stack_size > 0)
+        {
+            std::pair<uint32_t, uint32_t> pair = stack[--stack_size];
+            const Node& node = nodes[pair.first];
+            const typename Other::Node& other_node = other.nodes[pair.second];
+            if (node.isLeaf() && other_node.isLeaf())
+            {
+                stats.leaves_visited++;
+                for (uint32_t o = node.index; o < node.index + node.count; o++)
+                {
+                    for (uint32_t other_o = other_node.index; other_o < other_node.index + other_node.count; other_o++)
+                    {
+                        if (object_boxes[o].intersectsWith(other.object_boxes[other_o]))
+                            result.emplace_back(o, other_o);
+                    }
+                }
+                continue;
+            }
+            uint32_t children[2][2];
+            openLarger(other, pair.first, pair.second, children);
+            for (int c = 1; c >= 0; c--) // push the second child first, so that the result is in depth-first order
+            {
+                stats.nodes_visited++;
+                if (nodes[children[c][0]].box.intersectsWith(other.nodes[children[c][1]].box))
+                    stack[stack_size++] = std::make_pair(children[c][0], children[c][1]);
+            }
+        }
+    }
+
+    static double halfArea(const BoundingBox& b)
+    {
+        Point size = b.size();
+        return double(size.x) * size.y + double(size.y) * size.z + double(size.z) * size.x;
     };
-    template<typename GetVal>
-    static int select(std::vector<Node*>& list, int left, int right, int n, GetVal getVal)
+
+    void findDegraded(uint32_t node_idx, int node_depth, double max_growth, std::vector<std::pair<uint32_t, int>>& result)
     {
-         if (left == right)
-             return left;
-         while (true)
-         {
-             int pivotIndex = (right+left)/2;     // select pivotIndex between left and right
-             pivotIndex = partition(list, left, right, pivotIndex, getVal);
-             AABB_DEBUG_PRINTLN(" left = " << left << " right = " << right << " pivotIndex = " << pivotIndex <<"\t, \tn = " << n);
+        const Node& node = nodes[node_idx];
+        if (node.isLeaf()) return; // a leaf cannot be improved without its siblings
+        if (halfArea(node.box) > max_growth * node_build_areas[node_idx])
+        {
+            result.emplace_back(node_idx, node_depth);
+            return;
+        }
+        findDegraded(node_idx + 1, node_depth + 1, max_growth, result);
+        findDegraded(node.index, node_depth + 1, max_growth, result);
+    }
 
-             if (n == pivotIndex)       return n;
-             else if (n < pivotIndex)   right = pivotIndex - 1;
-             else                       left = pivotIndex + 1;
+    /*!
+    Replace the subtree of \p node_idx by a newly constructed subtree of the same objects.
+
+    The nodes of a subtree form a contiguous range of the node array, and its objects a contiguous range of the objects.
+    The new subtree may have a different number of nodes, so the indices of the nodes after the range are shifted.
+    */
+    void rebuildSubtree(uint32_t node_idx, int node_depth)
+    {
+        uint32_t last_node = node_idx; // the last node of the subtree is its rightmost leaf
+        while (!nodes[last_node].isLeaf()) last_node = nodes[last_node].index;
+        uint32_t first_leaf = node_idx; // the first leaf of the subtree is its leftmost leaf
+        while (!nodes[first_leaf].isLeaf()) first_leaf++;
+        uint32_t node_end = last_node + 1;
+        uint32_t object_begin = nodes[first_leaf].index;
+        uint32_t object_end = nodes[last_node].index + nodes[last_node].count;
+
+        std::vector<T> input(objects.begin() + object_begin, objects.begin() + object_end);
+        std::vector<BuildItem> items(input.size());
+        for (size_t i = 0; i < input.size(); i++)
+        {
+            items[i].box = object_boxes[object_begin + i];
+            items[i].object_idx = i;
+        }
+        Subtree subtree;
+        construct(input, items, node_depth, 0, items.size() - 1, subtree, getThreadCount());
+
+        // the objects stay in the same range, but in the order of the new leaves
+        std::copy(subtree.objects.begin(), subtree.objects.end(), objects.begin() + object_begin);
+        std::copy(subtree.object_boxes.begin(), subtree.object_boxes.end(), object_boxes.begin() + object_begin);
+        for (Node& node : subtree.nodes)
+        {
+            node.index += (node.isLeaf())? object_begin : node_idx;
+        }
+
+        int64_t shift = int64_t(subtree.nodes.size()) - (node_end - node_idx);
+        for (Node& node : nodes)
+        {
+            if (!node.isLeaf() && node.index >= node_end) node.index += shift;
+        }
+        nodes.erase(nodes.begin() + node_idx, nodes.begin() + node_end);
+        nodes.insert(nodes.begin() + node_idx, subtree.nodes.begin(), subtree.nodes.end());
+        depth = std::max(depth, subtree.depth);
+
+        std::vector<float> build_areas(subtree.nodes.size());
+        for (size_t n = 0; n < subtree.nodes.size(); n++)
+        {
+            build_areas[n] = halfArea(subtree.nodes[n].box);
+        }
+        node_build_areas.erase(node_build_areas.begin() + node_idx, node_build_areas.begin() + node_end);
+        node_build_areas.insert(node_build_areas.begin() + node_idx, build_areas.begin(), build_areas.end());
+    }
+
+    /*!
+    Traverse the tree with a packet of at most ray_packet_size rays at once.
+    A stack entry holds the bit mask of the rays of the packet which hit the node.
+    */
+    template<typename Intersect>
+    void closestHits(const Ray* rays, int packet_size, Intersect intersect, AABB_RayHit* hits)
+    {
+        static_assert(ray_packet_size <= 32, "the rays of a packet should fit in a bit mask");
+        struct StackEntry
+        {
+            uint32_t node_idx;
+            uint32_t ray_mask;
+        };
+        StackEntry stack[max_stack_size];
+        int stack_size = 0;
+        stack[stack_size++] = StackEntry{0, (uint32_t(1) << packet_size) - 1};
+        while (stack_size > 0)
+        {
+            StackEntry entry = stack[--stack_size];
+            const Node& node = nodes[entry.node_idx];
+            uint32_t ray_mask = 0;
+            for (int r = 0; r < packet_size; r++)
+            {
+                double t_entry;
+                if ((entry.ray_mask & (uint32_t(1) << r)) && rays[r].intersects(node.box, hits[r].t, t_entry))
+                    ray_mask |= uint32_t(1) << r;
+            }
+            if (ray_mask == 0) continue;
+
+            if (node.isLeaf())
+            {
+                for (uint32_t o = node.index; o < node.index + node.count; o++)
+                {
+                    for (int r = 0; r < packet_size; r++)
+                    {
+                        double t;
+                        if ((ray_mask & (uint32_t(1) << r)) && intersect(objects[o], rays[r], hits[r].t, t) && t <= hits[r].t)
+                        {
+                            hits[r].t = t;
+                            hits[r].object_idx = o;
+                        }
+                    }
+                }
+                continue;
+            }
+
+            // visit the child which lies first along the direction of the first ray first
+            uint32_t left = entry.node_idx + 1;
+            uint32_t right = node.index;
+            Point diff = nodes[right].box.mid() - nodes[left].box.mid();
+            int axis = (std::abs(diff.x) >= std::abs(diff.y))? ((std::abs(diff.x) >= std::abs(diff.z))? 0 : 2) : ((std::abs(diff.y) >= std::abs(diff.z))? 1 : 2);
+            int axis_diff = (axis == 0)? diff.x : (axis == 1)? diff.y : diff.z;
+            int first_ray = 0;
+            while (!(ray_mask & (uint32_t(1) << first_ray))) first_ray++;
+            if (rays[first_ray].direction[axis] * axis_diff < 0)
+                std::swap(left, right);
+            stack[stack_size++] = StackEntry{right, ray_mask};
+            stack[stack_size++] = StackEntry{left, ray_mask};
+        }
+    }
+
+    /*!
+    Call \p handle with the index of each object of which the bounding box intersects with \p bbox.
+    The tree is traversed depth-first using an explicit stack.
+    */
+    template<typename Handle>
+    void forEachIntersection(const BoundingBox& bbox, AABB_QueryStats* stats, Handle handle)
+    {
+        if (nodes.size() == 0) return;
+
+        uint32_t stack[max_stack_size];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0)
+        {
+            uint32_t node_idx = stack[--stack_size];
+            while (true)
+            {
+                const Node& node = nodes[node_idx];
+                if (stats) stats->nodes_visited++;
+                if (!node.box.intersectsWith(bbox)) break;
+
+                if (node.isLeaf())
+                {
+                    if (stats) stats->leaves_visited++;
+                    for (uint32_t o = node.index; o < node.index + node.count; o++)
+                    {
+                        if (object_boxes[o].intersectsWith(bbox))
+                        {
+                            AABB_DEBUG_PRINTLN("add element with box " << object_boxes[o].min << " - " << object_boxes[o].max << ");");
+                            handle(o);
+                        }
+                    }
+                    break;
+                }
+                stack[stack_size++] = node.index; // visit the right child later
+                node_idx++; // continue with the left child
+            }
         }
     }
-//    spaceType getDistance(BoundingBox a, BoundingBox b)
-//    {
-//
-//    };
 };
 
 #endif // AABB_TREE_H
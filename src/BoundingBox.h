@@ -100,6 +100,17 @@ struct BoundingBox
             );
     };
 
+    /*!
+    The squared distance from \p p to the nearest point in the box; zero when \p p lies inside.
+    */
+    double squaredDistance(const Point& p) const
+    {
+        double dx = (p.x < min.x)? double(min.x) - p.x : (p.x > max.x)? double(p.x) - max.x : 0;
+        double dy = (p.y < min.y)? double(min.y) - p.y : (p.y > max.y)? double(p.y) - max.y : 0;
+        double dz = (p.z < min.z)? double(min.z) - p.z : (p.z > max.z)? double(p.z) - max.z : 0;
+        return dx * dx + dy * dy + dz * dz;
+    };
+
     Point mid() const { return (max+min)/2; }; //!< the geometric middle of the box
 
     Point size() const { return max-min; }; //!< a point containing the width, height and depth information
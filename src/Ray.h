@@ -0,0 +1,112 @@
+#ifndef RAY_H
+#define RAY_H
+
+#include <math.h> // fabs
+#include <limits> // numeric_limits
+#include <algorithm> // min, max
+#include <utility> // swap
+#include "utils/intpoint.h" // Point3
+
+#include "BoundingBox.h"
+
+/*!
+A half line from an origin in a direction, in the integer (micron) coordinate space of the meshes.
+
+The points on the ray are origin + t * direction for t >= 0. The direction doesn't need to be normalized;
+t is then expressed in units of the length of the direction.
+
+The reciprocal of the direction is precomputed for the slab test against bounding boxes.
+*/
+struct Ray
+{
+    double origin[3];
+    double direction[3];
+    double inv_direction[3]; //!< 1 / direction, or infinity for a zero component
+
+    Ray(const Point3& o, const Point3& d)
+    {
+        origin[0] = o.x; origin[1] = o.y; origin[2] = o.z;
+        direction[0] = d.x; direction[1] = d.y; direction[2] = d.z;
+        for (int dim = 0; dim < 3; dim++)
+        {
+            inv_direction[dim] = (direction[dim] == 0)? std::numeric_limits<double>::infinity() : 1.0 / direction[dim];
+        }
+    };
+
+    //! the point on the ray at \p t, rounded to the integer grid
+    Point3 at(double t) const
+    {
+        return Point3(lround(origin[0] + t * direction[0]), lround(origin[1] + t * direction[1]), lround(origin[2] + t * direction[2]));
+    };
+
+    /*!
+    Slab test: whether the ray hits \p box for some t in [0, \p t_max].
+    \param t_entry output: the smallest such t
+    */
+    bool intersects(const BoundingBox& box, double t_max, double& t_entry) const
+    {
+        double t_min = 0;
+        const int32_t box_min[3] = { box.min.x, box.min.y, box.min.z };
+        const int32_t box_max[3] = { box.max.x, box.max.y, box.max.z };
+        for (int dim = 0; dim < 3; dim++)
+        {
+            if (direction[dim] == 0)
+            { // parallel to the slab: either always or never inside
+                if (origin[dim] < box_min[dim] || origin[dim] > box_max[dim]) return false;
+                continue;
+            }
+            double t0 = (box_min[dim] - origin[dim]) * inv_direction[dim];
+            double t1 = (box_max[dim] - origin[dim]) * inv_direction[dim];
+            if (t0 > t1) std::swap(t0, t1);
+            t_min = std::max(t_min, t0);
+            t_max = std::min(t_max, t1);
+            if (t_min > t_max) return false;
+        }
+        t_entry = t_min;
+        return true;
+    };
+
+    /*!
+    Möller-Trumbore test: whether the ray hits the triangle \p a, \p b, \p c for some t in [0, \p t_max].
+
+    Both sides of the triangle are hit, and points on its edges count as hits.
+    Rays in the plane of the triangle never hit it.
+    \param t output: the t of the hit
+    */
+    bool intersects(const Point3& a, const Point3& b, const Point3& c, double t_max, double& t) const
+    {
+        double e1[3] = { double(b.x) - a.x, double(b.y) - a.y, double(b.z) - a.z };
+        double e2[3] = { double(c.x) - a.x, double(c.y) - a.y, double(c.z) - a.z };
+        double p[3];
+        cross(direction, e2, p);
+        double det = dot(e1, p);
+        double e1_e2_size = sqrt(dot(e1, e1) * dot(e2, e2) * dot(direction, direction));
+        if (fabs(det) <= e1_e2_size * 1e-12) return false; // ray parallel to the triangle (or degenerate triangle)
+        double inv_det = 1.0 / det;
+
+        double s[3] = { origin[0] - a.x, origin[1] - a.y, origin[2] - a.z };
+        double u = dot(s, p) * inv_det;
+        if (u < 0 || u > 1) return false;
+
+        double q[3];
+        cross(s, e1, q);
+        double v = dot(direction, q) * inv_det;
+        if (v < 0 || u + v > 1) return false;
+
+        double t_hit = dot(e2, q) * inv_det;
+        if (t_hit < 0 || t_hit > t_max) return false;
+        t = t_hit;
+        return true;
+    };
+
+private:
+    static double dot(const double* a, const double* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+    static void cross(const double* a, const double* b, double* result)
+    {
+        result[0] = a[1] * b[2] - a[2] * b[1];
+        result[1] = a[2] * b[0] - a[0] * b[2];
+        result[2] = a[0] * b[1] - a[1] * b[0];
+    };
+};
+
+#endif // RAY_H
@@ -0,0 +1,339 @@
+#ifndef WIDE_AABB_TREE_H
+#define WIDE_AABB_TREE_H
+
+#include <limits> // numeric_limits
+#include <stdint.h>
+#include <vector>
+
+#ifdef __SSE2__
+#   include <emmintrin.h> // SSE2 integer compares
+#endif
+
+#include "AABB_Tree.h"
+
+#include "BoundingBox.h"
+
+#include "MACROS.h" // debug
+
+/*!
+Axis Aligned Bounding Box search tree with four children per node.
+
+The tree is obtained by collapsing an AABB_Tree: each node absorbs the children of its largest inner children until it has four children.
+The boxes of the four children are stored per coordinate (min x of all four children, then min y, etc.),
+so that a query box is tested against all children at once, using SSE2 when available.
+This roughly halves the depth of the tree and replaces the dependent per-node box tests by one independent test per four children.
+
+The leaves, the stored objects and their order are the same as those of the AABB_Tree it is collapsed from.
+
+@param T the type of object to be stored with/in the bounding boxes of leaves.
+@param Boxer policy which gives the bounding box of an object (see DefaultBoxer).
+@param SplitPolicy policy which determines how the binary tree is split (AABB_MedianSplit or AABB_SAHSplit).
+*/
+template<typename T, typename Boxer = DefaultBoxer<T>, typename SplitPolicy = AABB_MedianSplit>
+class WideAABB_Tree
+{
+public:
+    typedef AABB_Tree<T, Boxer, SplitPolicy> BinaryTree;
+
+    static const int width = 4; //!< the number of children per node
+
+    /*!
+    A node with the boxes of its (up to) four children.
+
+    A child is a leaf when its count is nonzero; it then refers to the objects [child, child + count).
+    Otherwise child is the index of the child node. Unused children have neither: their child and count are zero,
+    since the root is never a child. The box of an unused child is empty.
+    */
+    struct Node
+    {
+        int32_t min_x[width], min_y[width], min_z[width];
+        int32_t max_x[width], max_y[width], max_z[width];
+        uint32_t child[width]; //!< the index of the child node, or of the first object of a leaf
+        uint32_t count[width]; //!< the number of objects of a leaf; zero for inner and unused children
+
+        bool isUsed(int c) const { return child[c] != 0 || count[c] != 0; };
+        bool isLeaf(int c) const { return count[c] > 0; };
+        BoundingBox getBox(int c) const { return BoundingBox(min_x[c], min_y[c], min_z[c], max_x[c], max_y[c], max_z[c]); };
+        void setChild(int c, const BoundingBox& box, uint32_t child_idx, uint32_t child_count)
+        {
+            min_x[c] = box.min.x; min_y[c] = box.min.y; min_z[c] = box.min.z;
+            max_x[c] = box.max.x; max_y[c] = box.max.y; max_z[c] = box.max.z;
+            child[c] = child_idx;
+            count[c] = child_count;
+        };
+        void setUnused(int c)
+        {
+            setChild(c, BoundingBox(std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max()
+                                  , std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min()), 0, 0);
+        };
+    };
+    static_assert(sizeof(Node) == 128, "WideAABB_Tree nodes should fit in two cache lines");
+
+    std::vector<Node> nodes; //!< all nodes of the tree, in depth-first order; the root is the first node
+    std::vector<T> objects; //!< all objects, in the order of the leaves
+    std::vector<BoundingBox> object_boxes; //!< the bounding box of each object in \ref objects
+    int depth; //!< the depth of the tree
+
+private:
+    static const int max_stack_size = 4 * 128; //!< the binary tree is at most 128 deep, and each level of this tree holds at most 3 pending children on the stack
+
+    /*!
+    A query box, broadcast to all four lanes once per query.
+    */
+    struct Query
+    {
+#ifdef __SSE2__
+        __m128i min_x, min_y, min_z, max_x, max_y, max_z;
+        Query(const BoundingBox& b)
+        : min_x(_mm_set1_epi32(b.min.x)), min_y(_mm_set1_epi32(b.min.y)), min_z(_mm_set1_epi32(b.min.z))
+        , max_x(_mm_set1_epi32(b.max.x)), max_y(_mm_set1_epi32(b.max.y)), max_z(_mm_set1_epi32(b.max.z))
+        {};
+
+        //! the bit mask of the children of which the box intersects with the query box
+        int intersect(const Node& node) const
+        {
+            // a child is separated when its min > query max or query min > its max along any axis
+            __m128i separated = _mm_or_si128(
+                _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(node.min_x)), max_x),
+                _mm_cmpgt_epi32(min_x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(node.max_x))));
+            separated = _mm_or_si128(separated, _mm_or_si128(
+                _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(node.min_y)), max_y),
+                _mm_cmpgt_epi32(min_y, _mm_loadu_si128(reinterpret_cast<const __m128i*>(node.max_y)))));
+            separated = _mm_or_si128(separated, _mm_or_si128(
+                _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(node.min_z)), max_z),
+                _mm_cmpgt_epi32(min_z, _mm_loadu_si128(reinterpret_cast<const __m128i*>(node.max_z)))));
+            return ~_mm_movemask_ps(_mm_castsi128_ps(separated)) & 0xf;
+        };
+#else
+        BoundingBox box;
+        Query(const BoundingBox& b) : box(b) {};
+
+        //! the bit mask of the children of which the box intersects with the query box
+        int intersect(const Node& node) const
+        {
+            int mask = 0;
+            for (int c = 0; c < width; c++)
+            {
+                bool separated =
+                       node.min_x[c] > box.max.x || box.min.x > node.max_x[c]
+                    || node.min_y[c] > box.max.y || box.min.y > node.max_y[c]
+                    || node.min_z[c] > box.max.z || box.min.z > node.max_z[c];
+                mask |= (!separated) << c;
+            }
+            return mask;
+        };
+#endif
+    };
+
+public:
+    template<typename iterator>
+    WideAABB_Tree(iterator begin, iterator end)
+    : depth(0)
+    {
+        BinaryTree tree(begin, end);
+        collapse(tree);
+    };
+
+    WideAABB_Tree(const BinaryTree& tree)
+    : depth(0)
+    {
+        collapse(tree);
+    };
+
+    static void test()
+    {
+        struct IntBoxer
+        {
+            static BoundingBox bbox(int& i) { return BoundingBox(Point(i,i,i), Point3(i+1,i+1,i+1)); };
+        };
+
+        std::vector<int> ints = {8,7,6,5,4,3,2,1,0};
+
+        std::cerr << " TEST building WideAABB_Tree... " << std::endl;
+
+        WideAABB_Tree<int, IntBoxer> tree(ints.begin(), ints.end());
+
+        tree.debugPrint();
+
+        std::cerr << " TEST intersecting WideAABB_Tree... " << std::endl;
+
+        std::vector<int> intersections;
+        Point p_a(2,3,4);
+        Point3 p_b(5,6,7);
+        BoundingBox bbox(p_a, p_b);
+        AABB_QueryStats stats;
+        tree.getIntersections(bbox, intersections, &stats);
+
+        for (int i : intersections)
+            std::cerr << i << " ";
+        std::cerr << std::endl;
+        std::cerr << " visited " << stats.nodes_visited << " nodes, of which " << stats.leaves_visited << " leaves" << std::endl;
+    }
+
+    void debugPrint()
+    {
+        if (nodes.size() > 0) debugPrint(0, 0);
+
+        std:: cerr << std::endl;
+    }
+
+    /*!
+    Get all objects of which the bounding box intersects with \p bbox.
+    \param stats if given, the visited nodes are counted in it
+    */
+    void getIntersections(BoundingBox& bbox, std::vector<T>& result, AABB_QueryStats* stats = nullptr)
+    {
+        forEachIntersection(bbox, stats, [&result, this](uint32_t o) { result.push_back(objects[o]); });
+    }
+    void getIntersections(BoundingBox& bbox, std::vector<std::pair<BoundingBox, T>>& result, AABB_QueryStats* stats = nullptr)
+    {
+        forEachIntersection(bbox, stats, [&result, this](uint32_t o) { result.push_back(std::pair<BoundingBox, T>(object_boxes[o], objects[o])); });
+    }
+
+protected:
+    void debugPrint(uint32_t node_idx, int node_depth)
+    {
+        for (int c = 0; c < width; c++)
+        {
+            const Node& node = nodes[node_idx];
+            if (!node.isUsed(c)) continue;
+            BoundingBox box = node.getBox(c);
+            std::cerr << std::string(node_depth * 2, ' ') << box.min << "-" << box.max;
+            if (node.isLeaf(c))
+            {
+                for (uint32_t o = node.child[c]; o < node.child[c] + node.count[c]; o++)
+                    std:: cerr << "   " << objects[o];
+                std::cerr << std::endl;
+            }
+            else
+            {
+                std::cerr << std::endl;
+                debugPrint(node.child[c], node_depth + 1);
+            }
+        }
+    }
+
+    void collapse(const BinaryTree& tree)
+    {
+        objects = tree.objects;
+        object_boxes = tree.object_boxes;
+        if (tree.nodes.size() == 0) return;
+
+        nodes.reserve(tree.nodes.size() / 2 + 1);
+        if (tree.nodes[0].isLeaf())
+        { // a single leaf becomes the only child of the root
+            nodes.emplace_back();
+            nodes[0].setChild(0, tree.nodes[0].box, tree.nodes[0].index, tree.nodes[0].count);
+            for (int c = 1; c < width; c++)
+                nodes[0].setUnused(c);
+            depth = 1;
+            return;
+        }
+        collapse(tree, 0, 1);
+    }
+
+    /*!
+    Append the node which replaces the inner node \p binary_idx of \p tree and recursively its children.
+    \return the index of the appended node
+    */
+    uint32_t collapse(const BinaryTree& tree, uint32_t binary_idx, int node_depth)
+    {
+        depth = std::max(depth, node_depth);
+
+        typedef typename BinaryTree::Node BinaryNode;
+        uint32_t children[width];
+        int n_children = 0;
+        children[n_children++] = binary_idx + 1;
+        children[n_children++] = tree.nodes[binary_idx].index;
+        while (n_children < width)
+        { // open up the inner child with the largest box, since it is the most likely to be hit
+            int largest = -1;
+            double largest_area = -1;
+            for (int c = 0; c < n_children; c++)
+            {
+                const BinaryNode& child = tree.nodes[children[c]];
+                if (child.isLeaf()) continue;
+                double area = halfArea(child.box);
+                if (area > largest_area)
+                {
+                    largest = c;
+                    largest_area = area;
+                }
+            }
+            if (largest < 0) break; // all children are leaves
+            uint32_t opened = children[largest];
+            children[largest] = opened + 1;
+            children[n_children++] = tree.nodes[opened].index;
+        }
+
+        uint32_t node_idx = nodes.size();
+        nodes.emplace_back();
+        for (int c = 0; c < width; c++)
+        {
+            if (c >= n_children)
+            {
+                nodes[node_idx].setUnused(c);
+                continue;
+            }
+            const BinaryNode& child = tree.nodes[children[c]];
+            if (child.isLeaf())
+            {
+                nodes[node_idx].setChild(c, child.box, child.index, child.count);
+            }
+            else
+            {
+                uint32_t child_idx = collapse(tree, children[c], node_depth + 1);
+                nodes[node_idx].setChild(c, child.box, child_idx, 0);
+            }
+        }
+        return node_idx;
+    }
+
+    static double halfArea(const BoundingBox& b)
+    {
+        Point size = b.size();
+        return double(size.x) * size.y + double(size.y) * size.z + double(size.z) * size.x;
+    };
+
+    /*!
+    Call \p handle with the index of each object of which the bounding box intersects with \p bbox.
+    The tree is traversed depth-first using an explicit stack.
+    */
+    template<typename Handle>
+    void forEachIntersection(const BoundingBox& bbox, AABB_QueryStats* stats, Handle handle)
+    {
+        if (nodes.size() == 0) return;
+
+        Query query(bbox);
+        uint32_t stack[max_stack_size];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0)
+        {
+            const Node& node = nodes[stack[--stack_size]];
+            if (stats) stats->nodes_visited += width;
+            int mask = query.intersect(node);
+            for (int c = 0; c < width; c++)
+            {
+                if (!(mask & (1 << c))) continue;
+                if (node.isLeaf(c))
+                {
+                    if (stats) stats->leaves_visited++;
+                    for (uint32_t o = node.child[c]; o < node.child[c] + node.count[c]; o++)
+                    {
+                        if (object_boxes[o].intersectsWith(bbox))
+                        {
+                            handle(o);
+                        }
+                    }
+                }
+                else if (node.child[c] != 0)
+                {
+                    stack[stack_size++] = node.child[c];
+                }
+            }
+        }
+    }
+};
+
+#endif // WIDE_AABB_TREE_H
@@ -525,7 +525,7 @@ void BooleanMeshOps::perform(HE_Mesh& result)
     }
 
 BOOL_MESH_DEBUG_PRINTLN("constructing AABB-tree...");
-    AABB_Tree<HE_FaceHandle> keep_aabb(keep_faces.begin(), keep_faces.end());
+    WideAABB_Tree<HE_FaceHandle> keep_aabb(keep_faces.begin(), keep_faces.end());
 BOOL_MESH_DEBUG_PRINTLN("finished constructing AABB-tree");
 
 
@@ -1574,24 +1574,22 @@ void BooleanMeshOps::test_completeFractureLine()
     FMatrix3x3 transformation; // identity matrix
     bool success;
 
-    FVMesh keep_fv(nullptr);
-    success = loadModelSTL(&keep_fv, "/home/Dropbox/3D_models/Atlas_keep.stl", transformation);
+    HE_Mesh keep;
+    success = loadModelSTL(&keep, "/home/Dropbox/3D_models/Atlas_keep.stl", transformation);
     if (!success)
     {
         std::cerr << "loading model failed" << std::endl;
         exit(0);
     }
-    HE_Mesh keep(keep_fv);
 
 
-    FVMesh subtracted_fv(nullptr);
-    success = loadModelSTL(&subtracted_fv, "/home/Dropbox/3D_models/Atlas_subtracted.stl", transformation);
+    HE_Mesh subtracted;
+    success = loadModelSTL(&subtracted, "/home/Dropbox/3D_models/Atlas_subtracted.stl", transformation);
     if (!success)
     {
         std::cerr << "loading model failed" << std::endl;
         exit(0);
     }
-    HE_Mesh subtracted(subtracted_fv);
 
     test_completeFractureLine(keep, subtracted);
 
@@ -1633,6 +1631,7 @@ void BooleanMeshOps::test_completeFractureLine(PrintObject* model)
 //    other.vertices.emplace_back(mesh.bbox.mid() + Point3(-2*mesh.bbox.size().x,-2*mesh.bbox.size().y,-1000), 2);
     for (HE_Vertex& v : other.vertices)
         v.p += mesh.bbox.size()*3/10;
+    other.invalidateFaceAttributes();
 
     other.bbox = other.computeBbox();
 
@@ -1760,24 +1759,22 @@ void BooleanMeshOps::test_subtract()
     FMatrix3x3 transformation; // identity matrix
     bool success;
 
-    FVMesh keep_fv(nullptr);
-    success = loadModelSTL(&keep_fv, "/home/tim/Dropbox/3D_models/Atlas_keep.stl", transformation);
+    HE_Mesh keep;
+    success = loadModelSTL(&keep, "/home/tim/Dropbox/3D_models/Atlas_keep.stl", transformation);
     if (!success)
     {
         std::cerr << "loading keep model failed" << std::endl;
         exit(0);
     }
-    HE_Mesh keep(keep_fv);
 
 
-    FVMesh subtracted_fv(nullptr);
-    success = loadModelSTL(&subtracted_fv, "/home/tim/Dropbox/3D_models/Atlas_subtracted.stl", transformation);
+    HE_Mesh subtracted;
+    success = loadModelSTL(&subtracted, "/home/tim/Dropbox/3D_models/Atlas_subtracted.stl", transformation);
     if (!success)
     {
         std::cerr << "loading subtracted model failed" << std::endl;
         exit(0);
     }
-    HE_Mesh subtracted(subtracted_fv);
 
     test_subtract(keep, subtracted);
 }
@@ -1822,6 +1819,7 @@ void BooleanMeshOps::test_subtract(PrintObject* model)
 //    other.vertices.emplace_back(mesh.bbox.mid() + Point3(-2*mesh.bbox.size().x,-2*mesh.bbox.size().y,-1000), 2);
     for (HE_Vertex& v : other.vertices)
         v.p += mesh.bbox.size()*3/10;
+    other.invalidateFaceAttributes();
 
     other.bbox = other.computeBbox();
 
@@ -19,7 +19,7 @@
 
 #include "Kernel.h"
 
-#include "AABB_Tree.h"
+#include "WideAABB_Tree.h"
 #include "mesh/Mesh.h"
 #include "mesh/FVMesh.h"
 #include "mesh/HalfEdgeMesh.h"
@@ -14,6 +14,8 @@
 
 #include "MACROS.h" // debug
 
+#include "utils/parallel.h" // parallelForRanges
+
 #include <fstream> // write to file (debug)
 
 #include <boost/iterator/transform_iterator.hpp>
@@ -299,7 +301,8 @@ void BooleanMeshOps::subtract(HE_Mesh& keep, HE_Mesh& subtracted, HE_Mesh& resul
 void BooleanMeshOps::createIntersectionSegmentSoup(
     Face2Soup& fracture_soup_keep,
     Face2Soup& fracture_soup_subtracted,
-    AABB_Tree<HE_FaceHandle>& keep_aabb,
+    FaceTree& keep_aabb,
+    FaceTree& subtracted_aabb,
     std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>>& coplanarKeepToSubtracted     )
 {
     BOOL_MESH_OPS_DEBUG_PRINTLN("=====================================");
@@ -307,53 +310,64 @@ void BooleanMeshOps::createIntersectionSegmentSoup(
     long totalTriTriIntersectionComputations = 0;
     long totalTriTriIntersections = 0;
 
-    for (int f = 0 ; f < subtracted.faces.size() ; f++)
-    {
-        HE_FaceHandle face_subtracted(subtracted, f);
+    std::vector<std::pair<uint32_t, uint32_t>> intersectingBboxFaces; // pairs of indices of faces of keep and of subtracted
+    keep_aabb.getOverlappingPairs(subtracted_aabb, intersectingBboxFaces);
+    for (std::pair<uint32_t, uint32_t>& intersectingBboxFace : intersectingBboxFaces)
+    { // from indices into the objects of the trees to face indices
+        intersectingBboxFace.first = keep_aabb.objects[intersectingBboxFace.first].idx;
+        intersectingBboxFace.second = subtracted_aabb.objects[intersectingBboxFace.second].idx;
+    }
 
-        BoundingBox tribbox = face_subtracted.bbox();
-        std::vector<HE_FaceHandle> intersectingBboxFaces;
-        keep_aabb.getIntersections(tribbox, intersectingBboxFaces);
-//        std::vector<std::pair<BoundingBox, HE_FaceHandle>> intersectingBboxFaces2;
-//        keep_aabb.getIntersections(tribbox, intersectingBboxFaces2);
+    // remove the pairs which are separated by the plane of either face, in batches
+    TriangleIntersectionComputation::removeSeparatedByPlanes(keep.getFaceAttributes(), subtracted.getFaceAttributes(), intersectingBboxFaces);
 
-        totalTriTriIntersectionComputations += intersectingBboxFaces.size();
+    totalTriTriIntersectionComputations += intersectingBboxFaces.size();
 
-        for (const HE_FaceHandle intersectingBboxFace : intersectingBboxFaces)
+    // intersect the pairs on all cores: each range of pairs collects its results in buffers of its own,
+    // which are merged into the maps in the order of the ranges, so the maps are filled in the same order as by a serial loop over the pairs
+    // the face attributes used by the intersection were computed above, so the meshes are only read
+    unsigned int n_ranges = getThreadCount();
+    std::vector<std::vector<TriangleIntersection>> line_segments(n_ranges); // only the pairs which actually intersect get a TriangleIntersection
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> line_segment_faces(n_ranges); // the pair of faces of each line segment
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> coplanar_faces(n_ranges);
+    parallelForRanges(intersectingBboxFaces.size(), n_ranges, [&](unsigned int r, size_t begin, size_t end)
         {
+            for (size_t p = begin; p < end; p++)
+            {
+                const std::pair<uint32_t, uint32_t>& intersectingBboxFace = intersectingBboxFaces[p];
+                HE_FaceHandle tri1(keep, intersectingBboxFace.first);
+                HE_FaceHandle tri2(subtracted, intersectingBboxFace.second);
 
-            HE_FaceHandle tri1 = HE_FaceHandle(intersectingBboxFace);
-            HE_FaceHandle& tri2 = face_subtracted;
-
-            std::shared_ptr<TriangleIntersection> triangleIntersection = getIntersection(tri1, tri2);
+                IntersectionType intersectionType = TriangleIntersectionComputation::intersect(tri1, tri2, line_segments[r]);
 
-    //            if (!triangleIntersection->from || !triangleIntersection->to)
-            if (triangleIntersection->intersectionType == IntersectionType::LINE_SEGMENT)
-            {
-                hashMapInsert(fracture_soup_keep, tri1, tri2, *triangleIntersection);
-                hashMapInsert(fracture_soup_subtracted, tri2, tri1, *triangleIntersection);
-            } else if (triangleIntersection->intersectionType == IntersectionType::COPLANAR)
-            {
-                // TODO: move outside?
-                auto coplanarMapInsert = [](std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>>& coplanarKeepToSubtracted, HE_FaceHandle& tri1, HE_FaceHandle& tri2)
+                if (intersectionType == IntersectionType::LINE_SEGMENT)
                 {
-                    typedef std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>>::iterator iter;
-                    iter found = coplanarKeepToSubtracted.find(tri1);
-                    if ( found == coplanarKeepToSubtracted.end())
-                    {
-                        std::unordered_set<HE_FaceHandle> coplanarTo;
-                        coplanarTo.emplace(tri2);
-                        coplanarKeepToSubtracted.emplace(tri1, coplanarTo);
-                    } else
-                    {
-                        found->second.emplace(tri2);
-                    }
-                };
-                coplanarMapInsert(coplanarKeepToSubtracted, tri1, tri2);
+                    line_segment_faces[r].push_back(intersectingBboxFace);
+                } else if (intersectionType == IntersectionType::COPLANAR)
+                {
+                    coplanar_faces[r].push_back(intersectingBboxFace);
+                }
             }
+        }, 256);
 
+    for (unsigned int r = 0; r < n_ranges; r++)
+    {
+        totalTriTriIntersections += line_segments[r].size();
+        for (unsigned int s = 0; s < line_segments[r].size(); s++)
+        {
+            HE_FaceHandle tri1(keep, line_segment_faces[r][s].first);
+            HE_FaceHandle tri2(subtracted, line_segment_faces[r][s].second);
+            hashMapInsert(fracture_soup_keep, tri1, tri2, line_segments[r][s]);
+            hashMapInsert(fracture_soup_subtracted, tri2, tri1, line_segments[r][s]);
+        }
+        for (const std::pair<uint32_t, uint32_t>& coplanar : coplanar_faces[r])
+        {
+            HE_FaceHandle tri1(keep, coplanar.first);
+            HE_FaceHandle tri2(subtracted, coplanar.second);
+            coplanarKeepToSubtracted[tri1].emplace(tri2);
         }
     }
+
     BOOL_MESH_OPS_DEBUG_SHOW(totalTriTriIntersectionComputations);
     BOOL_MESH_OPS_DEBUG_SHOW(totalTriTriIntersections);
     BOOL_MESH_OPS_DEBUG_PRINTLN("average # intersection computations per triangle: "<< float(totalTriTriIntersectionComputations) / subtracted.faces.size());
@@ -420,11 +434,13 @@ void BooleanMeshOps::hashMapInsert(std::unordered_map<HE_FaceHandle, std::unorde
 
 
 typedef std::unordered_map<IntersectionPoint , Node*, IntersectionPointHasher> Point2fracNode;
+typedef BucketGrid3D<Node*> NodeGrid; //!< the nodes of a fracture by location; used to merge points which lie within the meld distance of a node
 
 
 void addVertexPointsToFracture(
     std::unordered_map<HE_FaceHandle, TriangleIntersection>& segments,
     std::unordered_map<IntersectionPoint , Node*, IntersectionPointHasher>& point2fracNode,
+    NodeGrid& node_grid,
     FractureLinePart& frac,
     const HE_FaceHandle tri_keep
     )
@@ -480,7 +496,7 @@ void addVertexPointsToFracture(
                 } while (out_edge != v.someEdge());
 
                 node->data /= n_connected_segments; // average over all connected IntersectionPoints
-
+                node_grid.insert(node->data, node);
             }
         };
         handleFromOrTo(true);
@@ -492,6 +508,7 @@ void addVertexPointsToFracture(
 void addUnhandledNonVertexPointsToFracture (
     std::unordered_map<HE_FaceHandle, TriangleIntersection>& segments,
     std::unordered_map<IntersectionPoint , Node*, IntersectionPointHasher>& point2fracNode,
+    NodeGrid& node_grid,
     FractureLinePart& frac,
     const HE_FaceHandle tri_keep
     )
@@ -507,41 +524,56 @@ void addUnhandledNonVertexPointsToFracture (
             IntersectionPoint intersectionPoint = (from)? *line.from : *line.to;
             if (intersectionPoint.type == IntersectionPointType::NEW && point2fracNode.find(intersectionPoint) == point2fracNode.end())
             {
-                Node* node = frac.fracture.addNode(intersectionPoint.p());
-                point2fracNode.emplace(intersectionPoint, node);
+                auto addNode = [&]()
+                {
+                    Node* node = frac.fracture.addNode(intersectionPoint.p());
+                    point2fracNode.emplace(intersectionPoint, node);
+                    return node;
+                };
 
 //BOOL_MESH_OPS_DEBUG_PRINTLN("adding new node for ");
 //intersectionPoint.debugOutput();
 //
                 HE_EdgeHandle e = intersectionPoint.edge;
 
-                if (e.face() == tri_keep) return;
-
-                int n_connected_segments = 1;
+                if (e.face() == tri_keep)
+                {
+                    Node* node = addNode();
+                    node_grid.insert(node->data, node);
+                    return;
+                }
 
                 HE_FaceHandle connected_face = e.converse().face();
                 auto connected_segment_found = segments.find(connected_face);
-                if (connected_segment_found != segments.end())
+                if (connected_segment_found == segments.end())
                 {
-                    TriangleIntersection& connected_segment = connected_segment_found->second;
-                    IntersectionPoint* closest_to_intersectionPoint = nullptr;
-                    { // get closest point
-                        if ( (connected_segment.from->p() - intersectionPoint.p()).vSize() < (connected_segment.to->p() - intersectionPoint.p()).vSize() )
-                            closest_to_intersectionPoint = &*connected_segment.from;
-                        else
-                            closest_to_intersectionPoint = &*connected_segment.to;
+                    Node* close_node;
+                    if (node_grid.findNearestObject(intersectionPoint.p(), close_node))
+                    { // merge with the node which lies within the meld distance, without creating a node for this point
+                        point2fracNode[intersectionPoint] = close_node;
+                        return;
                     }
-//BOOL_MESH_OPS_DEBUG_PRINTLN("and for ");
-//closest_to_intersectionPoint->debugOutput();
-                    point2fracNode.emplace(*closest_to_intersectionPoint, node);
-                    node->data += closest_to_intersectionPoint->p();
-                    n_connected_segments++; // n_connected_segments = 2;
-                } else
-                {
-                    BOOL_MESH_OPS_DEBUG_PRINTLN("ERROR! couldn't find intersectionintersection of connected face!  >> search nearby nodes?"); // TODO use utils/BucketGrid3D::findCloseObjects
+                    BOOL_MESH_OPS_DEBUG_PRINTLN("ERROR! couldn't find intersection of connected face, nor a nearby node!");
+                    Node* node = addNode();
+                    node_grid.insert(node->data, node);
+                    return;
+                }
 
+                Node* node = addNode();
+                TriangleIntersection& connected_segment = connected_segment_found->second;
+                IntersectionPoint* closest_to_intersectionPoint = nullptr;
+                { // get closest point
+                    if ( (connected_segment.from->p() - intersectionPoint.p()).vSize() < (connected_segment.to->p() - intersectionPoint.p()).vSize() )
+                        closest_to_intersectionPoint = &*connected_segment.from;
+                    else
+                        closest_to_intersectionPoint = &*connected_segment.to;
                 }
-                node->data /= n_connected_segments; // average over all connected IntersectionPoints
+//BOOL_MESH_OPS_DEBUG_PRINTLN("and for ");
+//closest_to_intersectionPoint->debugOutput();
+                point2fracNode.emplace(*closest_to_intersectionPoint, node);
+                node->data += closest_to_intersectionPoint->p();
+                node->data /= 2; // average over both connected IntersectionPoints
+                node_grid.insert(node->data, node);
 
             }
         };
@@ -553,6 +585,7 @@ void addUnhandledNonVertexPointsToFracture (
 void BooleanMeshOps::connectNodesInFracture (
     std::unordered_map<HE_FaceHandle, TriangleIntersection>& segments,
     std::unordered_map<IntersectionPoint , Node*, IntersectionPointHasher>& point2fracNode,
+    NodeGrid& node_grid,
     const std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>>& coplanarKeepToSubtracted,
     FractureLinePart& frac,
     HE_FaceHandle tri_main,
@@ -575,18 +608,28 @@ void BooleanMeshOps::connectNodesInFracture (
             if (point_n_fracNode_found != point2fracNode.end())
             {
                 ret = point_n_fracNode_found->second;
+            } else if (node_grid.findNearestObject(intersectionPoint.p(), ret))
+            { // the point doesn't map to a node itself, but lies within the meld distance of one
+                point2fracNode.emplace(intersectionPoint, ret);
             } else
             {
                 BOOL_MESH_OPS_DEBUG_PRINTLN("ERROR! (?) couldn't find node in hashmap!!!!!!!!! : ");
                 intersectionPoint.debugOutput();
                 //std::exit(0);
                 ret = frac.fracture.addNode(intersectionPoint.p());
+                point2fracNode.emplace(intersectionPoint, ret);
+                node_grid.insert(ret->data, ret);
                 //averageGraphNodePosition = true;
             }
             return ret;
         };
         Node* from_node = getNode(true);
         Node* to_node = getNode(false);
+        if (from_node == to_node)
+        { // the segment is shorter than the meld distance and both its ends were merged into the same node
+            BOOL_MESH_OPS_DEBUG_PRINTLN("skipping segment of which both ends map to the same node");
+            continue;
+        }
 
         // TODO: move outside
         // check edgeCases => edge-triangle intersection
@@ -809,14 +852,16 @@ void BooleanMeshOps::getFace2fractures(
         std::unordered_set<std::pair<TriangleIntersection, bool>, IntersectionPointHasher> already_connected_points;
 
         Point2fracNode point2fracNode;
+        NodeGrid node_grid(MELD_DISTANCE);
+        node_grid.reserve(segments.size() * 2);
 
         { // add all intersections to graph
 
-            addVertexPointsToFracture(segments, point2fracNode, frac, tri_keep);
+            addVertexPointsToFracture(segments, point2fracNode, node_grid, frac, tri_keep);
 
-            addUnhandledNonVertexPointsToFracture(segments, point2fracNode, frac, tri_keep);
+            addUnhandledNonVertexPointsToFracture(segments, point2fracNode, node_grid, frac, tri_keep);
 
-            connectNodesInFracture(segments, point2fracNode, coplanarKeepToSubtracted, frac, tri_keep, keep);
+            connectNodesInFracture(segments, point2fracNode, node_grid, coplanarKeepToSubtracted, frac, tri_keep, keep);
         }
 
 
@@ -851,6 +896,10 @@ void BooleanMeshOps::perform(HE_Mesh& result)
 
 
 
+    // the face normals, planes and bounding boxes are used by the AABB trees, the intersections and the fractures
+    keep.getFaceAttributes();
+    subtracted.getFaceAttributes();
+
     std::vector<HE_FaceHandle> keep_faces;
     for (int f = 0; f < keep.faces.size(); f++)
     {
@@ -858,7 +907,14 @@ void BooleanMeshOps::perform(HE_Mesh& result)
     }
 
 BOOL_MESH_OPS_DEBUG_PRINTLN("constructing AABB-tree...");
-    AABB_Tree<HE_FaceHandle> keep_aabb(keep_faces.begin(), keep_faces.end());
+    FaceTree keep_aabb(keep_faces.begin(), keep_faces.end());
+
+    std::vector<HE_FaceHandle> subtracted_faces;
+    for (int f = 0; f < subtracted.faces.size(); f++)
+    {
+        subtracted_faces.emplace_back(subtracted, f);
+    }
+    FaceTree subtracted_aabb(subtracted_faces.begin(), subtracted_faces.end());
 BOOL_MESH_OPS_DEBUG_PRINTLN("finished constructing AABB-tree");
 
     Face2Soup fracture_soup_keep;
@@ -866,7 +922,7 @@ BOOL_MESH_OPS_DEBUG_PRINTLN("finished constructing AABB-tree");
 
     std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>> coplanarKeepToSubtracted;
 
-    createIntersectionSegmentSoup(fracture_soup_keep, fracture_soup_subtracted, keep_aabb, coplanarKeepToSubtracted);
+    createIntersectionSegmentSoup(fracture_soup_keep, fracture_soup_subtracted, keep_aabb, subtracted_aabb, coplanarKeepToSubtracted);
 
 
     std::unordered_map<HE_FaceHandle, FractureLinePart> face2fractures_keep;
@@ -1132,6 +1188,61 @@ void BooleanMeshOps::debug_export_problem(HE_FaceHandle triangle1, std::shared_p
 
 
 
+void BooleanMeshOps::test_shortSegment()
+{
+    std::cerr << " TEST fracture of a segment shorter than the meld distance... " << std::endl;
+
+    // the keep mesh is a tetrahedron with a horizontal top face at z=0
+    HE_Mesh keep;
+    Point k0(0, 0, 0), k1(100000, 0, 0), k2(0, 100000, 0), k3(0, 0, -100000);
+    keep.addFace(k0, k1, k2);
+    keep.addFace(k0, k3, k1);
+    keep.addFace(k1, k3, k2);
+    keep.addFace(k0, k2, k3);
+    keep.finish();
+
+    // the tip of the subtracted tetrahedron pokes 100 micron through the top face of keep, where its faces are about 20 micron wide
+    HE_Mesh subtracted;
+    Point s0(20000, 20000, -100), s1(10000, 20000, 100000), s2(30000, 10000, 100000), s3(30000, 30000, 100000);
+    subtracted.addFace(s0, s1, s2);
+    subtracted.addFace(s0, s3, s1);
+    subtracted.addFace(s1, s3, s2);
+    subtracted.addFace(s0, s2, s3);
+    subtracted.finish();
+
+    BooleanMeshOps ops(keep, subtracted, BoolOpType::DIFFERENCE);
+
+    // only one of the segments around the tip, so that its ends have no connected segments and both merge into the first node made
+    Face2Soup fracture_soup_keep;
+    HE_FaceHandle top(keep, 0);
+    for (size_t f = 0; f < subtracted.faces.size() && fracture_soup_keep.empty(); f++)
+    {
+        HE_FaceHandle tip_face(subtracted, f);
+        std::vector<TriangleIntersection> line_segments;
+        if (TriangleIntersectionComputation::intersect(top, tip_face, line_segments) == IntersectionType::LINE_SEGMENT)
+            ops.hashMapInsert(fracture_soup_keep, top, tip_face, line_segments[0]);
+    }
+    if (fracture_soup_keep.empty())
+    {
+        std::cerr << " FAILED: the tip doesn't intersect the top face" << std::endl;
+        return;
+    }
+    TriangleIntersection& segment = fracture_soup_keep[top].begin()->second;
+    int64_t length = (segment.to->p() - segment.from->p()).vSize();
+
+    std::unordered_map<HE_FaceHandle, FractureLinePart> face2fractures_keep;
+    std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>> coplanarKeepToSubtracted;
+    ops.getFace2fractures(fracture_soup_keep, face2fractures_keep, true, coplanarKeepToSubtracted);
+
+    int self_loops = 0;
+    for (Arrow* a : face2fractures_keep.at(top).fracture.arrows)
+        self_loops += a->from == a->to;
+    std::cerr << " segment of " << length << " micron; " << face2fractures_keep.at(top).fracture.nodes.size() << " nodes, "
+        << face2fractures_keep.at(top).fracture.arrows.size() << " arrows, " << self_loops << " self-loops" << std::endl;
+    if (length >= MELD_DISTANCE || self_loops > 0)
+        std::cerr << " FAILED!" << std::endl;
+}
+
 void BooleanMeshOps::test_subtract()
 {
     std::remove("CRAP.csv");
@@ -1143,24 +1254,22 @@ void BooleanMeshOps::test_subtract()
     FMatrix3x3 transformation; // identity matrix
     bool success;
 
-    FVMesh keep_fv(nullptr);
-    success = loadModelSTL(&keep_fv, "/home/tim/Dropbox/3D_models/Atlas_keep.stl", transformation);
+    HE_Mesh keep;
+    success = loadModelSTL(&keep, "/home/tim/Dropbox/3D_models/Atlas_keep.stl", transformation);
     if (!success)
     {
         std::cerr << "loading keep model failed" << std::endl;
         exit(0);
     }
-    HE_Mesh keep(keep_fv);
 
 
-    FVMesh subtracted_fv(nullptr);
-    success = loadModelSTL(&subtracted_fv, "/home/tim/Dropbox/3D_models/Atlas_subtracted.stl", transformation);
+    HE_Mesh subtracted;
+    success = loadModelSTL(&subtracted, "/home/tim/Dropbox/3D_models/Atlas_subtracted.stl", transformation);
     if (!success)
     {
         std::cerr << "loading subtracted model failed" << std::endl;
         exit(0);
     }
-    HE_Mesh subtracted(subtracted_fv);
 
     test_subtract(keep, subtracted);
 }
@@ -1205,6 +1314,7 @@ void BooleanMeshOps::test_subtract(PrintObject* model)
 //    other.vertices.emplace_back(mesh.bbox.mid() + Point3(-2*mesh.bbox.size().x,-2*mesh.bbox.size().y,-1000), 2);
     for (HE_Vertex& v : other.vertices)
         v.p += mesh.bbox.size()*3/10;
+    other.invalidateFaceAttributes();
 
     other.bbox = other.computeBbox();
 
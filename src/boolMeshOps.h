@@ -180,7 +180,9 @@ protected:
 
     typedef std::unordered_map<HE_FaceHandle, std::unordered_map<HE_FaceHandle, TriangleIntersection>> Face2Soup;
 
-    void createIntersectionSegmentSoup(Face2Soup& fracture_soup_keep, Face2Soup& fracture_soup_subtracted, AABB_Tree<HE_FaceHandle>& keep_aabb, std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>>& coplanarKeepToSubtracted);
+    typedef AABB_Tree<HE_FaceHandle, DefaultBoxer<HE_FaceHandle>, AABB_SAHSplit> FaceTree;
+
+    void createIntersectionSegmentSoup(Face2Soup& fracture_soup_keep, Face2Soup& fracture_soup_subtracted, FaceTree& keep_aabb, FaceTree& subtracted_aabb, std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>>& coplanarKeepToSubtracted);
 
     void hashMapInsert(std::unordered_map<HE_FaceHandle, std::unordered_map<HE_FaceHandle, TriangleIntersection>>& fractures, HE_FaceHandle tri1, HE_FaceHandle tri2, TriangleIntersection& triangleIntersection);
 
@@ -193,6 +195,7 @@ protected:
     void connectNodesInFracture (
         std::unordered_map<HE_FaceHandle, TriangleIntersection>& segments,
         std::unordered_map<IntersectionPoint , Node*, IntersectionPointHasher>& point2fracNode,
+        BucketGrid3D<Node*>& node_grid,
         const std::unordered_map<HE_FaceHandle, std::unordered_set<HE_FaceHandle>>& coplanarKeepToSubtracted,
         FractureLinePart& frac,
         const HE_FaceHandle tri_main,
@@ -200,6 +203,7 @@ protected:
         );
 
 public:
+    static void test_shortSegment(); //!< checks that a segment shorter than the meld distance doesn't become a self-loop in the fracture
     static void test_subtract();
     static void test_subtract(PrintObject* model);
     static void test_subtract(HE_Mesh& keep, HE_Mesh& subtracted);
@@ -101,16 +101,9 @@ void CommandSocket::handleIncommingData(fffProcessor* processor)
             {
                 int faceCount = dataSize / 4 / 3 / 3;
                 logError("Reading %i faces\n", faceCount);
-                for(int n=0; n<faceCount; n++)
-                {
-                    FPoint3 fv[3];
-                    socket.recvAll(fv, 4 * 3 * 3);
-                    Point3 v[3];
-                    v[0] = matrix.apply(fv[0]);
-                    v[1] = matrix.apply(fv[1]);
-                    v[2] = matrix.apply(fv[2]);
-                    mesh->addFace(v[0], v[1], v[2]);
-                }
+                std::vector<float> fv(faceCount * 3 * 3);
+                socket.recvAll(fv.data(), 4 * 3 * 3 * faceCount);
+                mesh->addFaces(fv.data(), faceCount, matrix);
                 mesh->finish();
             }else{
                 for(int n=0; n<dataSize; n++)
@@ -23,6 +23,7 @@
 
 #include "mesh/HalfEdgeMeshVertex.h" // testGetConnectedEdgeGroups
 #include "mesh/HEPMeshVertex.h" // testGetConnectedEdgeGroups
+#include "mesh/HEPMesh.h" // testPerformance
 //#include "boolMesh.h" //test_getFacetIntersectionlineSegment
 #include "boolMeshOps.h" //test_getFacetIntersectionlineSegment
 #include "utils/PlaneEquation.h" // test()
@@ -97,6 +98,7 @@ public:
 
 //        HE_VertexHandle::testGetConnectedEdgeGroups();
 //        HEP_VertexHandle::testGetConnectedEdgeGroups();
+//        HEP_Mesh::testPerformance(model->meshes[0]);
 
 //        HE_Mesh::testMakeManifold(model);
 
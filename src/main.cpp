@@ -54,11 +54,19 @@ using namespace atlas;
 
 
 #include "AABB_Tree.h"
+#include "WideAABB_Tree.h"
+#include "mesh/HalfEdgeMesh.h"
+#include "triangleIntersect.h"
+#include "boolMeshOps.h"
 void main_test(int argc, char **argv)
 {
     std::cerr << " Program TEST begin... " << std::endl;
 
     AABB_Tree<int>::test();
+    WideAABB_Tree<int>::test();
+    HE_Mesh::test();
+    TriangleIntersectionComputation::testRemoveSeparatedByPlanes();
+    boolOps::BooleanMeshOps::test_shortSegment();
 
 }
 
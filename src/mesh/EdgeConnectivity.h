@@ -0,0 +1,163 @@
+#ifndef EDGE_CONNECTIVITY_H
+#define EDGE_CONNECTIVITY_H
+
+#include <stdint.h>
+#include <vector>
+#include <cmath> // atan2
+
+#include "../Kernel.h"
+#include "../utils/logoutput.h"
+#include "../utils/parallel.h"
+
+/*!
+Computes which faces of a welded triangle soup are connected via which edges.
+
+Face edge i of face f (from vertex i to vertex (i+1)%3) is identified by the index f*3+i.
+All face edges are sorted on the key (min(v0,v1), max(v0,v1)), which puts the face edges sharing the same vertices next to each other.
+For the common case of exactly two faces sharing an edge this directly gives the connection.
+Only for non-manifold edges, with more than two faces, the faces are ordered around the edge; see getConnectedFaceEdgeAroundEdge.
+*/
+class EdgeConnectivity
+{
+    struct EdgeKey
+    {
+        uint64_t key; //!< (lowest vertex index << 32) | highest vertex index
+        uint32_t face_edge; //!< face index * 3 + index of the edge within the face
+        bool operator<(const EdgeKey& other) const { return key < other.key || (key == other.key && face_edge < other.face_edge); }
+    };
+public:
+    /*!
+    Compute for each face edge the face edge of the face connected via it.
+
+    \param n_faces the number of faces
+    \param get_vertex get_vertex(f, i) should return the index of vertex i of face f
+    \param get_point get_point(v) should return the location of the vertex with index v
+    \param result for each face edge (face index * 3 + edge index) the face edge it's connected to, or -1 if there is none
+    */
+    template<typename GetVertex, typename GetPoint>
+    static void connectFaceEdges(size_t n_faces, const GetVertex& get_vertex, const GetPoint& get_point, std::vector<int>& result)
+    {
+        size_t n_face_edges = n_faces * 3;
+        std::vector<EdgeKey> keys(n_face_edges);
+        parallelFor(n_faces, [&](size_t f)
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    uint32_t v0 = get_vertex(f, i);
+                    uint32_t v1 = get_vertex(f, (i + 1) % 3);
+                    keys[f * 3 + i].key = (v0 < v1)? (uint64_t(v0) << 32) | v1 : (uint64_t(v1) << 32) | v0;
+                    keys[f * 3 + i].face_edge = f * 3 + i;
+                }
+            });
+        parallelSort(keys.begin(), keys.end(), [](const EdgeKey& a, const EdgeKey& b) { return a < b; });
+
+        result.resize(n_face_edges);
+        parallelForRanges(n_face_edges, [&](unsigned int, size_t begin, size_t end)
+            {
+                // only handle the groups of equal keys starting in this range
+                size_t group_start = begin;
+                while (group_start > 0 && group_start < n_face_edges && keys[group_start - 1].key == keys[group_start].key)
+                    group_start++;
+                while (group_start < end)
+                {
+                    size_t group_end = group_start + 1;
+                    while (group_end < n_face_edges && keys[group_end].key == keys[group_start].key)
+                        group_end++;
+                    size_t group_size = group_end - group_start;
+                    if (group_size == 1)
+                    {
+                        atlas::logError("Couldn't find face connected to face %i.\n", int(keys[group_start].face_edge / 3));
+                        result[keys[group_start].face_edge] = -1;
+                    }
+                    else if (group_size == 2)
+                    {
+                        result[keys[group_start].face_edge] = keys[group_start + 1].face_edge;
+                        result[keys[group_start + 1].face_edge] = keys[group_start].face_edge;
+                    }
+                    else
+                    {
+                        for (size_t e = group_start; e < group_end; e++)
+                            result[keys[e].face_edge] = getConnectedFaceEdgeAroundEdge(keys[e].face_edge, &keys[group_start], &keys[group_end], get_vertex, get_point);
+                    }
+                    group_start = group_end;
+                }
+            });
+    }
+
+private:
+    /*!
+    Returns the face edge of the 'other' face connected to face edge \p face_edge, among the face edges in [\p candidates_begin, \p candidates_end) which all share the same two vertices.
+    The next face in a counter-clockwise ordering (looking from the to-vertex to the from-vertex of \p face_edge) is returned.
+
+    \cond DOXYGEN_EXCLUDE
+        [NON-RENDERED COMENTS]
+        For two faces abc and abd with normals n and m, we have that:
+        \f{eqnarray*}{
+        n &=& \frac{ab \times ac}{\|ab \times ac\|}     \\
+        m &=& \frac{ab \times ad}{\|ab \times ad\|}     \\
+        n \times m &=& \|n\| \cdot \|m\| \mathbf{p} \sin \alpha  \\
+        && (\mathbf{p} \perp n \wedge \mathbf{p} \perp m) \\
+        \sin \alpha &=& \|n \times m \|
+        &=& \left\| \frac{(ab \times ac) \times (ab \times ad)}{\|ab \times ac\| \cdot \|ab \times ad\|}  \right\|    \\
+        &=& \left\| \frac{ (ab \cdot (ac \times ad)) ab  }{\|ab \times ac\| \cdot \|ab \times ad\|}  \right\|    \\
+        &=&  \frac{ (ab \cdot (ac \times ad)) \left\| ab   \right\| }{\|ab\| \|ac\| \sin bac \cdot \|ab\| \|ad\| \sin bad}    \\
+        &=&  \frac{  ab \cdot (ac \times ad)  }{\|ab\| \|ac\| \|ad\|  \sin bac \sin bad}    \\
+        \f}}
+    \endcond
+
+    See <a href="http://stackoverflow.com/questions/14066933/direct-way-of-computing-clockwise-angle-between-2-vectors">Direct way of computing clockwise angle between 2 vectors</a>
+    */
+    template<typename GetVertex, typename GetPoint>
+    static int getConnectedFaceEdgeAroundEdge(uint32_t face_edge, const EdgeKey* candidates_begin, const EdgeKey* candidates_end, const GetVertex& get_vertex, const GetPoint& get_point)
+    {
+        int notFaceIdx = face_edge / 3;
+        int idx0 = get_vertex(notFaceIdx, face_edge % 3);
+        int idx1 = get_vertex(notFaceIdx, (face_edge + 1) % 3);
+        int notFaceVertexIdx = get_vertex(notFaceIdx, (face_edge + 2) % 3); // the third vertex of the face
+
+        size_t n_candidates = candidates_end - candidates_begin - 1;
+        if (n_candidates % 2 == 0) atlas::log("Warning! Edge with uneven number of faces connecting it!(%i)\n", int(n_candidates + 1));
+
+        FPoint3 vn = get_point(idx1) - get_point(idx0);
+        FPoint3 n = vn / vn.vSize(); // the normal of the plane in which all normals of faces connected to the edge lie => the normalized normal
+        FPoint3 v0 = get_point(idx1) - get_point(idx0);
+
+    // the normals below are abnormally directed! : these normals all point counterclockwise (viewed from idx1 to idx0) from the face, irrespective of the direction of the face.
+        FPoint3 n0 = FPoint3(get_point(notFaceVertexIdx) - get_point(idx0)).cross(v0);
+
+        if (n0.vSize() <= 0) atlas::log("Warning! Face %i has zero area!\n", notFaceIdx);
+
+        double smallestAngle = 1000; // more then 2 PI (impossible angle)
+        int bestFaceEdge = -1;
+
+        for (const EdgeKey* candidate = candidates_begin; candidate != candidates_end; candidate++)
+        {
+            int candidateFace = candidate->face_edge / 3;
+            if (candidateFace == notFaceIdx)
+                continue;
+            int candidateVertexIdx = get_vertex(candidateFace, (candidate->face_edge + 2) % 3); // the vertex of the face besides idx0 and idx1
+
+            FPoint3 v1 = get_point(candidateVertexIdx) - get_point(idx0);
+            FPoint3 n1 = v1.cross(v0);
+
+            double dot = n0 * n1;
+            double det = n * n0.cross(n1);
+            double angle = std::atan2(det, dot);
+            if (angle < 0) angle += 2*M_PI; // 0 <= angle < 2* M_PI
+
+            if (angle == 0)
+            {
+                atlas::log("Warning! Overlapping faces: face %i and face %i.\n", notFaceIdx, candidateFace);
+            }
+            if (angle < smallestAngle)
+            {
+                smallestAngle = angle;
+                bestFaceEdge = candidate->face_edge;
+            }
+        }
+        if (bestFaceEdge < 0) atlas::logError("Couldn't find face connected to face %i.\n", notFaceIdx);
+        return bestFaceEdge;
+    }
+};
+
+#endif//EDGE_CONNECTIVITY_H
@@ -1,15 +1,15 @@
 #include "FVMesh.h"
 #include "../utils/logoutput.h"
+#include "../utils/parallel.h"
+
+#include "EdgeConnectivity.h"
 
 
 const int vertex_meld_distance = MM2INT(0.03);
-static inline uint32_t pointHash(Point3& p)
-{
-    return ((p.x + vertex_meld_distance/2) / vertex_meld_distance) ^ (((p.y + vertex_meld_distance/2) / vertex_meld_distance) << 10) ^ (((p.z + vertex_meld_distance/2) / vertex_meld_distance) << 20);
-}
 
 FVMesh::FVMesh(SettingsBase* parent)
 : Mesh(parent)
+, vertex_hash_table(vertex_meld_distance)
 {
 }
 
@@ -36,22 +36,93 @@ void FVMesh::addFace(Point3& v0, Point3& v1, Point3& v2)
     face.vertex_index[0] = vi0;
     face.vertex_index[1] = vi1;
     face.vertex_index[2] = vi2;
-    vertices[face.vertex_index[0]].connected_faces.push_back(idx);
-    vertices[face.vertex_index[1]].connected_faces.push_back(idx);
-    vertices[face.vertex_index[2]].connected_faces.push_back(idx);
+}
+
+void FVMesh::addFaces(const float* tris, size_t n, const FMatrix3x3& matrix)
+{
+    std::vector<Point3> points(n * 3);
+    parallelFor(n * 3, [&](size_t i)
+        {
+            const float* v = tris + i * 3;
+            points[i] = matrix.apply(FPoint3(v[0], v[1], v[2]));
+        });
+    addFaces(points.data(), n);
+}
+
+/*!
+Of all points at exactly the same location only the first is looked up in the vertex_hash_table; see VertexHashTable::findFirstOccurrences.
+For a closed mesh every location occurs about 6 times, so this leaves only about a sixth of the lookups to the sequential part.
+*/
+void FVMesh::addFaces(const Point3* tri_vertices, size_t n)
+{
+    size_t n_points = n * 3;
+    reserve(n);
+
+    std::vector<uint32_t> first_occurrence;
+    VertexHashTable::findFirstOccurrences(tri_vertices, n_points, first_occurrence);
+
+    std::vector<int> vertex_idx(n_points);
+    for (size_t i = 0; i < n_points; i++)
+    {
+        if (first_occurrence[i] == i)
+            vertex_idx[i] = findIndexOfVertex(tri_vertices[i]);
+        else
+            vertex_idx[i] = vertex_idx[first_occurrence[i]];
+    }
+
+    // emit the non-degenerate faces in order: count them per range, so that each range knows where to put its faces
+    std::vector<size_t> range_face_counts(getThreadCount() + 1, 0);
+    auto isDegenerate = [&vertex_idx](size_t f)
+        {
+            int vi0 = vertex_idx[f * 3], vi1 = vertex_idx[f * 3 + 1], vi2 = vertex_idx[f * 3 + 2];
+            return vi0 == vi1 || vi1 == vi2 || vi0 == vi2; // the face has two vertices which get assigned the same location. Don't add the face.
+        };
+    parallelForRanges(n, range_face_counts.size() - 1, [&](unsigned int range, size_t begin, size_t end)
+        {
+            for (size_t f = begin; f < end; f++)
+                if (!isDegenerate(f))
+                    range_face_counts[range + 1]++;
+        });
+    range_face_counts[0] = faces.size();
+    for (size_t r = 1; r < range_face_counts.size(); r++)
+        range_face_counts[r] += range_face_counts[r - 1]; // now holds the index of the first face of each range
+    faces.resize(range_face_counts.back());
+    parallelForRanges(n, range_face_counts.size() - 1, [&](unsigned int range, size_t begin, size_t end)
+        {
+            size_t idx = range_face_counts[range];
+            for (size_t f = begin; f < end; f++)
+            {
+                if (isDegenerate(f))
+                    continue;
+                FVMeshFace& face = faces[idx++];
+                face.vertex_index[0] = vertex_idx[f * 3];
+                face.vertex_index[1] = vertex_idx[f * 3 + 1];
+                face.vertex_index[2] = vertex_idx[f * 3 + 2];
+            }
+        });
 }
 
 void FVMesh::clear()
 {
     faces.clear();
     vertices.clear();
-    vertex_hash_map.clear();
+    vertex_hash_table.clear();
+    vertex_face_offsets.clear();
+    vertex_faces.clear();
+}
+
+void FVMesh::reserve(size_t n_faces)
+{
+    size_t n_vertices = vertices.size() + n_faces / 2 + 2; // a closed manifold has about half as many vertices as faces
+    faces.reserve(faces.size() + n_faces);
+    vertices.reserve(n_vertices);
+    vertex_hash_table.reserve(n_vertices);
 }
 
 void FVMesh::finish()
 {
-    // Finish up the mesh, clear the vertex_hash_map, as it's no longer needed from this point on and uses quite a bit of memory.
-    vertex_hash_map.clear();
+    // Finish up the mesh, clear the vertex_hash_table, as it's no longer needed from this point on and uses quite a bit of memory.
+    vertex_hash_table.clear();
 
     if (vertices.size()==0) bbox = BoundingBox(0,0,0,0,0,0);
     else                    bbox = BoundingBox(vertices[0].p, vertices[0].p);
@@ -61,15 +132,36 @@ void FVMesh::finish()
         bbox += p; // expand box to include p
     }
 
-    // For each face, store which other face is connected with it.
-    for(unsigned int i=0; i<faces.size(); i++)
+    // Store the faces connected to each vertex: count them per vertex first, so that they can be placed in a single array
+    vertex_face_offsets.assign(vertices.size() + 1, 0);
+    for (const FVMeshFace& face : faces)
+        for (int i = 0; i < 3; i++)
+            vertex_face_offsets[face.vertex_index[i] + 1]++;
+    for (unsigned int v = 1; v < vertex_face_offsets.size(); v++)
+        vertex_face_offsets[v] += vertex_face_offsets[v - 1];
+    vertex_faces.resize(faces.size() * 3);
     {
-        FVMeshFace& face = faces[i];
-        face.connected_face_index[0] = getFaceIdxWithPoints(face.vertex_index[0], face.vertex_index[1], i); // faces are connected via the outside
-        face.connected_face_index[1] = getFaceIdxWithPoints(face.vertex_index[1], face.vertex_index[2], i);
-        face.connected_face_index[2] = getFaceIdxWithPoints(face.vertex_index[2], face.vertex_index[0], i);
+        std::vector<uint32_t> insert_position(vertex_face_offsets.begin(), vertex_face_offsets.end() - 1);
+        for (unsigned int f = 0; f < faces.size(); f++)
+            for (int i = 0; i < 3; i++)
+                vertex_faces[insert_position[faces[f].vertex_index[i]]++] = f;
     }
 
+    // For each face, store which other face is connected with it.
+    std::vector<int> connected_face_edge;
+    EdgeConnectivity::connectFaceEdges(faces.size()
+        , [this](size_t f, int i) { return faces[f].vertex_index[i]; }
+        , [this](int v) { return vertices[v].p; }
+        , connected_face_edge);
+    parallelFor(faces.size(), [&](size_t f)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                int other = connected_face_edge[f * 3 + i];
+                faces[f].connected_face_index[i] = (other < 0)? -1 : other / 3; // faces are connected via the outside
+            }
+        });
+
 }
 
 /*
@@ -100,114 +192,13 @@ Point3 FVMesh::max()
     return ret;
 }
 */
-int FVMesh::findIndexOfVertex(Point3& v)
+int FVMesh::findIndexOfVertex(const Point3& v)
 {
-    uint32_t hash = pointHash(v);
+    int idx = vertex_hash_table.find(v, [this](uint32_t vertex_idx) { return vertices[vertex_idx].p; });
+    if (idx >= 0)
+        return idx;
 
-    for(unsigned int idx = 0; idx < vertex_hash_map[hash].size(); idx++)
-    {
-        if ((vertices[vertex_hash_map[hash][idx]].p - v).testLength(vertex_meld_distance))
-        {
-            return vertex_hash_map[hash][idx];
-        }
-    }
-    vertex_hash_map[hash].push_back(vertices.size());
+    vertex_hash_table.insert(v, vertices.size());
     vertices.emplace_back(v);
     return vertices.size() - 1;
 }
-
-/*!
-Returns the index of the 'other' face connected to the edge between vertices with indices idx0 and idx1.
-In case more than two faces are connected via the same edge, the next face in a counter-clockwise ordering (looking from idx1 to idx0) is returned.
-
-\cond DOXYGEN_EXCLUDE
-    [NON-RENDERED COMENTS]
-    For two faces abc and abd with normals n and m, we have that:
-    \f{eqnarray*}{
-    n &=& \frac{ab \times ac}{\|ab \times ac\|}     \\
-    m &=& \frac{ab \times ad}{\|ab \times ad\|}     \\
-    n \times m &=& \|n\| \cdot \|m\| \mathbf{p} \sin \alpha  \\
-    && (\mathbf{p} \perp n \wedge \mathbf{p} \perp m) \\
-    \sin \alpha &=& \|n \times m \|
-    &=& \left\| \frac{(ab \times ac) \times (ab \times ad)}{\|ab \times ac\| \cdot \|ab \times ad\|}  \right\|    \\
-    &=& \left\| \frac{ (ab \cdot (ac \times ad)) ab  }{\|ab \times ac\| \cdot \|ab \times ad\|}  \right\|    \\
-    &=&  \frac{ (ab \cdot (ac \times ad)) \left\| ab   \right\| }{\|ab\| \|ac\| \sin bac \cdot \|ab\| \|ad\| \sin bad}    \\
-    &=&  \frac{  ab \cdot (ac \times ad)  }{\|ab\| \|ac\| \|ad\|  \sin bac \sin bad}    \\
-    \f}}
-\endcond
-
-See <a href="http://stackoverflow.com/questions/14066933/direct-way-of-computing-clockwise-angle-between-2-vectors">Direct way of computing clockwise angle between 2 vectors</a>
-
-
-*/
-int FVMesh::getFaceIdxWithPoints(int idx0, int idx1, int notFaceIdx)
-{
-    std::vector<int> candidateFaces; // in case more than two faces meet at an edge, multiple candidates are generated
-    int notFaceVertexIdx = -1; // index of the third vertex of the face corresponding to notFaceIdx
-    for(int f : vertices[idx0].connected_faces) // search through all faces connected to the first vertex and find those that are also connected to the second
-    {
-        if (f == notFaceIdx)
-        {
-            for (int i = 0; i<3; i++) // find the vertex which is not idx0 or idx1
-                if (faces[f].vertex_index[i] != idx0 && faces[f].vertex_index[i] != idx1)
-                    notFaceVertexIdx = faces[f].vertex_index[i];
-            continue;
-        }
-        if ( faces[f].vertex_index[0] == idx1 // && faces[f].vertex_index[1] == idx0 // next face should have the right direction!
-          || faces[f].vertex_index[1] == idx1 // && faces[f].vertex_index[2] == idx0
-          || faces[f].vertex_index[2] == idx1 // && faces[f].vertex_index[0] == idx0
-            )  candidateFaces.push_back(f);
-
-    }
-
-    if (candidateFaces.size() == 0) { atlas::logError("Couldn't find face connected to face %i.\n", notFaceIdx); return -1; }
-    if (candidateFaces.size() == 1) { return candidateFaces[0]; }
-
-
-    if (notFaceVertexIdx < 0) { atlas::logError("Couldn't find third point on face %i.\n", notFaceIdx); return -1; }
-
-    if (candidateFaces.size() % 2 == 0) atlas::log("Warning! Edge with uneven number of faces connecting it!(%i)\n", candidateFaces.size()+1);
-
-    FPoint3 vn = vertices[idx1].p - vertices[idx0].p;
-    FPoint3 n = vn / vn.vSize(); // the normal of the plane in which all normals of faces connected to the edge lie => the normalized normal
-    FPoint3 v0 = vertices[idx1].p - vertices[idx0].p;
-
-// the normals below are abnormally directed! : these normals all point counterclockwise (viewed from idx1 to idx0) from the face, irrespective of the direction of the face.
-    FPoint3 n0 = FPoint3(vertices[notFaceVertexIdx].p - vertices[idx0].p).cross(v0);
-
-    if (n0.vSize() <= 0) atlas::log("Warning! Face %i has zero area!\n", notFaceIdx);
-
-    double smallestAngle = 1000; // more then 2 PI (impossible angle)
-    int bestIdx = -1;
-
-    for (int candidateFace : candidateFaces)
-    {
-        int candidateVertex;
-        {// find third vertex belonging to the face (besides idx0 and idx1)
-            for (candidateVertex = 0; candidateVertex<3; candidateVertex++)
-                if (faces[candidateFace].vertex_index[candidateVertex] != idx0 && faces[candidateFace].vertex_index[candidateVertex] != idx1)
-                    break;
-        }
-
-        FPoint3 v1 = vertices[candidateVertex].p -vertices[idx0].p;
-        FPoint3 n1 = v1.cross(v0);
-
-        double dot = n0 * n1;
-        double det = n * n0.cross(n1);
-        double angle = std::atan2(det, dot);
-        if (angle < 0) angle += 2*M_PI; // 0 <= angle < 2* M_PI
-
-        if (angle == 0)
-        {
-            atlas::log("Warning! Overlapping faces: face %i and face %i.\n", notFaceIdx, candidateFace);
-            //std::cerr<< n.vSize() <<"; "<<n1.vSize()<<";"<<n0.vSize() <<std::endl;
-        }
-        if (angle < smallestAngle)
-        {
-            smallestAngle = angle;
-            bestIdx = candidateFace;
-        }
-    }
-    if (bestIdx < 0) atlas::logError("Couldn't find face connected to face %i.\n", notFaceIdx);
-    return bestIdx;
-}
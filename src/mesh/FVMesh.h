@@ -13,12 +13,17 @@
 #include "FVMeshFace.h"
 #include "FVMeshVertex.h"
 
+#include "VertexHashTable.h"
+
 /*!
 An FVMesh is a basic representation of a 3D model. It contains all the faces as FVMeshFaces.
 
-A face is represented by 3 verts, and a vert is represented by a point in 3D and it also knows all connected faces.
-Moreover, a face knows to which faces it is connected.
-This last property is computed when finish() is called.
+A face is represented by 3 verts, and a vert is represented by a point in 3D.
+The mesh also knows which faces are connected to each vertex, and a face knows to which faces it is connected.
+These last two properties are computed when finish() is called.
+
+The faces connected to each vertex are stored in compressed sparse row format:
+a single array with the face indices of all vertices one after another, and an array with the offset in that array per vertex.
 
 An FVMesh is an implementation of the <a href="http://en.wikipedia.org/wiki/Polygon_mesh#Face-vertex_meshes">Face-vertex mesh datastructure</a>
 , with the additional trait of a face which stores the 3 connected faces.
@@ -27,27 +32,39 @@ See FVMeshFace for the specifics of how/when faces are connected.
 */
 class FVMesh : public Mesh<FVMeshVertex, FVMeshVertexHandle, FVMeshFace, FVMeshFaceHandle> // inherits from mesh interface
 {
-    //! The vertex_hash_map stores a index reference of each vertex for the hash of that location. Allows for quick retrieval of points with the same location.
-    std::map<uint32_t, std::vector<uint32_t> > vertex_hash_map;
+    //! The vertex_hash_table stores a index reference of each vertex for the cell of that location. Allows for quick retrieval of points with the same location.
+    VertexHashTable vertex_hash_table;
+    std::vector<uint32_t> vertex_face_offsets; //!< the connected faces of vertex v are vertex_faces[vertex_face_offsets[v]] up to vertex_faces[vertex_face_offsets[v+1]]
+    std::vector<uint32_t> vertex_faces; //!< the indices of the faces connected to each vertex; see vertex_face_offsets
 public:
     typedef FVMeshVertex Vertex;
     typedef FVMeshFace Face;
     FVMesh(SettingsBase* parent); //!< initializes the settings
 
-    void addFace(Point3& v0, Point3& v1, Point3& v2); //!< add a face to the mesh without settings it's connected_faces.
+    void addFace(Point3& v0, Point3& v1, Point3& v2); //!< add a face to the mesh without settings it's connected faces.
+    /*!
+    Add \p n faces at once; the result is exactly the same as calling addFace for each face in turn.
+    \param tris 9 floats per face: x, y and z of each of the three vertices, in mm
+    \param matrix the transformation applied to each vertex
+    */
+    void addFaces(const float* tris, size_t n, const FMatrix3x3& matrix);
+    void addFaces(const Point3* tri_vertices, size_t n); //!< add \p n faces at once, given as 3 consecutive vertices per face; see addFaces above
     void clear(); //!< clears all data
-    void finish(); //!< complete the model : set the connected_face_index fields of the faces.
+    void reserve(size_t n_faces); //!< prepare for adding \p n_faces more faces, so that no reallocations are needed while adding them
+    void finish(); //!< complete the model : compute the faces connected to each vertex and set the connected_face_index fields of the faces.
+
+    //! The faces connected to the vertex with index \p vertex_idx. Only available after finish() has been called.
+    FVMeshConnectedFaces getConnectedFaces(int vertex_idx) const
+    {
+        const uint32_t* faces_begin = vertex_faces.data();
+        return FVMeshConnectedFaces{ faces_begin + vertex_face_offsets[vertex_idx], faces_begin + vertex_face_offsets[vertex_idx + 1] };
+    }
 
     void debugOuputBasicStats(std::ostream& out);
 
 
 private:
-    int findIndexOfVertex(Point3& v); //!< find index of vertex close to the given point, or create a new vertex and return its index.
-    /*!
-    Get the index of the face connected to the face with index \p notFaceIdx, via vertices \p idx0 and \p idx1.
-    In case multiple faces connect with the same edge, return the next counter-clockwise face when viewing from \p idx1 to \p idx0.
-    */
-    int getFaceIdxWithPoints(int idx0, int idx1, int notFaceIdx);
+    int findIndexOfVertex(const Point3& v); //!< find index of vertex close to the given point, or create a new vertex and return its index.
 };
 
 
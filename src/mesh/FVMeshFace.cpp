@@ -4,17 +4,17 @@
 #include "FVMeshVertex.h"
 
 
-FVMeshVertexHandle FVMeshFaceHandle::v0()
+FVMeshVertexHandle FVMeshFaceHandle::v0() const
 {
     return FVMeshVertexHandle(*m, m->faces[idx].vertex_index[0]);
 }
 
-FVMeshVertexHandle FVMeshFaceHandle::v1()
+FVMeshVertexHandle FVMeshFaceHandle::v1() const
 {
     return FVMeshVertexHandle(*m, m->faces[idx].vertex_index[1]);
 }
 
-FVMeshVertexHandle FVMeshFaceHandle::v2()
+FVMeshVertexHandle FVMeshFaceHandle::v2() const
 {
     return FVMeshVertexHandle(*m, m->faces[idx].vertex_index[2]);
 }
@@ -51,13 +51,13 @@ public:
 
 
 
-struct FVMeshFaceHandle : public MeshFaceHandle<FVMeshVertex, FVMeshVertexHandle, FVMeshFace, FVMesh>
+struct FVMeshFaceHandle : public MeshFaceHandle<FVMeshFaceHandle, FVMeshVertex, FVMeshVertexHandle, FVMeshFace, FVMesh>
 {
     FVMeshFaceHandle(FVMesh& m, int idx) : MeshFaceHandle(m, idx) {};
 
-    FVMeshVertexHandle v0();
-    FVMeshVertexHandle v1();
-    FVMeshVertexHandle v2();
+    FVMeshVertexHandle v0() const;
+    FVMeshVertexHandle v1() const;
+    FVMeshVertexHandle v2() const;
 };
 
 
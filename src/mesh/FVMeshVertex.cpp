@@ -4,3 +4,8 @@ FVMeshVertex& FVMeshVertexHandle::vertex()
 {
     return m->vertices[idx];
 };
+
+FVMeshConnectedFaces FVMeshVertexHandle::connectedFaces()
+{
+    return m->getConnectedFaces(idx);
+}
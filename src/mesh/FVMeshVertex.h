@@ -11,14 +11,28 @@
 /*!
 Vertex type to be used in a FVMesh.
 
-Keeps track of which faces connect to it.
+Which faces connect to a vertex is stored by the FVMesh itself; see FVMesh::getConnectedFaces.
 */
 class FVMeshVertex : public MeshVertex
 {
 public:
-    std::vector<uint32_t> connected_faces; //!< list of the indices of connected faces
+    FVMeshVertex(Point p) : MeshVertex(p) {}
+};
+
+/*!
+The indices of the faces connected to a vertex, in increasing order.
+
+This is a view into the adjacency arrays of an FVMesh, which are only valid after FVMesh::finish() has been called.
+*/
+struct FVMeshConnectedFaces
+{
+    const uint32_t* begin_;
+    const uint32_t* end_;
 
-    FVMeshVertex(Point p) : MeshVertex(p) {} //!< doesn't set connected_faces
+    const uint32_t* begin() const { return begin_; }
+    const uint32_t* end() const { return end_; }
+    size_t size() const { return end_ - begin_; }
+    uint32_t operator[](size_t i) const { return begin_[i]; }
 };
 
 
@@ -31,6 +45,7 @@ struct FVMeshVertexHandle : public MeshVertexHandle<FVMeshVertex, FVMeshFace, FV
     FVMeshVertexHandle(FVMesh& m, int idx) : MeshVertexHandle(m, idx) {};
 
     FVMeshVertex& vertex();
+    FVMeshConnectedFaces connectedFaces(); //!< the faces connected to this vertex
 };
 
 #endif//FVMESHVERTEX_H
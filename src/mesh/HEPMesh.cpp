@@ -1,5 +1,6 @@
 #include "HEPMesh.h"
 #include "../utils/logoutput.h"
+#include "../utils/gettime.h"
 
 
 
@@ -36,35 +37,24 @@ void HEP_Mesh::connectEdgesConverse(HEP_Edge* e1, HEP_Edge* e2) { e1->converse_e
 
 HEP_Vertex* HEP_Mesh::createVertex(Point p)
 {
-    HEP_Vertex vert(p, nullptr);
-    vertices.push_back(vert);
-    return &vertices[vertices.size()-1];
+    return &vertices.emplace_back(p, nullptr);
 }
 
 HEP_Edge* HEP_Mesh::createConverse(HEP_Edge* e)
 {
     HEP_Vertex* v1 = e->next_edge->from_vert; //edges[e].to_vert;
-    HEP_Edge new_e(v1, nullptr);
-    edges.push_back(new_e);
-    connectEdgesConverse(e, &edges[edges.size()-1]);
-    return &edges[edges.size()-1];
+    HEP_Edge* new_e = &edges.emplace_back(v1, nullptr);
+    connectEdgesConverse(e, new_e);
+    return new_e;
 }
 
 HEP_Face* HEP_Mesh::createFace(HEP_Vertex* v0, HEP_Vertex* v1, HEP_Vertex* v2)
 {
-        HEP_Face f;
-        faces.push_back(f);
-        HEP_Face* fP = &faces[faces.size()-1];
+        HEP_Face* fP = &faces.emplace_back(); // the pools never move their elements, so we can keep pointers to them
 
-        HEP_MESH_DEBUG_PRINTLN("taking pointer to vector element!");
-        exit(0);
-
-        HEP_Edge e0 (v0, fP);
-        HEP_Edge e1 (v1, fP);
-        HEP_Edge e2 (v2, fP);
-        edges.push_back(e0); HEP_Edge* e0P = &edges[edges.size()-1];
-        edges.push_back(e1); HEP_Edge* e1P = &edges[edges.size()-1];
-        edges.push_back(e2); HEP_Edge* e2P = &edges[edges.size()-1];
+        HEP_Edge* e0P = &edges.emplace_back(v0, fP);
+        HEP_Edge* e1P = &edges.emplace_back(v1, fP);
+        HEP_Edge* e2P = &edges.emplace_back(v2, fP);
 
         connectEdgesPrevNext(e0P, e1P);
         connectEdgesPrevNext(e1P, e2P);
@@ -78,7 +68,7 @@ HEP_Face* HEP_Mesh::createFace(HEP_Vertex* v0, HEP_Vertex* v1, HEP_Vertex* v2)
         fP->edge[1] = e1P;
         fP->edge[2] = e2P;
 
-        return &faces[faces.size()-1];
+        return fP;
 }
 
 //int HEP_Mesh::createFaceWithEdge(int e0, int v2)
@@ -170,6 +160,10 @@ HEP_Mesh::~HEP_Mesh()
 HEP_Mesh::HEP_Mesh(HE_Mesh& mesh)
 : Mesh(nullptr)
 {
+    vertices.reserve(mesh.vertices.size());
+    faces.reserve(mesh.faces.size());
+    edges.reserve(mesh.edges.size());
+
     for (int eIdx = 0 ; eIdx < mesh.edges.size() ; eIdx++)
     {
         edges.push_back(HEP_Edge()); // fully uninitialized edge!
@@ -194,7 +188,7 @@ HEP_Mesh::HEP_Mesh(HE_Mesh& mesh)
         HE_Edge& hee = mesh.edges[eIdx];
         edges[eIdx].from_vert = &vertices[hee.from_vert_idx];
         edges[eIdx].next_edge = &edges[hee.next_edge_idx];
-        edges[eIdx].converse_edge = &edges[hee.converse_edge_idx];
+        edges[eIdx].converse_edge = (hee.converse_edge_idx < 0)? nullptr : &edges[hee.converse_edge_idx];
         edges[eIdx].face = & faces[hee.face_idx];
     }
 
@@ -202,69 +196,35 @@ HEP_Mesh::HEP_Mesh(HE_Mesh& mesh)
 HEP_Mesh::HEP_Mesh(FVMesh& mesh)
 : Mesh(nullptr)
 {
-    std::cerr << " HEP_Mesh(FVMesh& mesh)   seems to be not working! maybe use HEP_Mesh(HE_Mesh(FvMesh& mesh)) instead! " << std::endl;
-    std::exit(1);
+    vertices.reserve(mesh.vertices.size());
+    faces.reserve(mesh.faces.size());
+    edges.reserve(mesh.faces.size() * 3);
 
     for (int vIdx = 0 ; vIdx < mesh.vertices.size() ; vIdx++)
     {
-        vertices.push_back(HEP_Vertex(mesh.vertices[vIdx].p, nullptr));
+        createVertex(mesh.vertices[vIdx].p);
     }
 
     for (int fIdx = 0 ; fIdx < mesh.faces.size() ; fIdx++)
     {
         FVMeshFace& face = mesh.faces[fIdx];
-        HEP_Face heFace;
-        faces.push_back(heFace);
-        HEP_Face* heFaceP = &faces[faces.size()-1];
-
-        HEP_Edge edge0(&vertices[face.vertex_index[0]], heFaceP); // vertices in face are ordered counter-clockwise
-        HEP_Edge edge1(&vertices[face.vertex_index[1]], heFaceP);
-        HEP_Edge edge2(&vertices[face.vertex_index[2]], heFaceP);
-
-        edges.push_back(edge0); HEP_Edge* edge0P = &edges[edges.size()-1];
-        edges.push_back(edge1); HEP_Edge* edge1P = &edges[edges.size()-1];
-        edges.push_back(edge2); HEP_Edge* edge2P = &edges[edges.size()-1];
-
-
-        vertices[ face.vertex_index[0] ].someEdge = edge0P; // overwrites existing data, if present
-        vertices[ face.vertex_index[1] ].someEdge = edge1P;
-        vertices[ face.vertex_index[2] ].someEdge = edge2P;
-
-        edge0.next_edge = edge1P;
-        edge1.next_edge = edge2P;
-        edge2.next_edge = edge0P;
-
-        heFace.edge[0] = edge0P;
-        heFace.edge[1] = edge1P;
-        heFace.edge[2] = edge2P;
-
+        createFace(&vertices[face.vertex_index[0]], &vertices[face.vertex_index[1]], &vertices[face.vertex_index[2]]); // vertices in face are ordered counter-clockwise
     }
 
 
     // connect half-edges:
 
-    bool faceEdgeIsConnected[mesh.faces.size()][3] = {}; // initialize all as false
-
-
     // for each edge of each face : if it doesn't have a converse then find the converse in the edges of the opposite face
     for (int fIdx = 0 ; fIdx < mesh.faces.size() ; fIdx++)
     {
         FVMeshFace& face = mesh.faces[fIdx];
 
-        HEP_Face* heFaceP = &faces[faces.size()-1];
-
-        HEP_FaceHandle fnew(*this, heFaceP); // face index on FVMesh corresponds to index in HEP_Mesh
+        HEP_Face& heFace = faces[fIdx]; // face index on FVMesh corresponds to index in HEP_Mesh
 
-//        HEP_EdgeHandle edge = fnew.edge0();
-//        HEP_EdgeHandle edgeStart = edge;
-//        do //
         for (int eIdx = 0; eIdx < 3; eIdx++)
         {
-            if (faceEdgeIsConnected[fIdx][eIdx])
-                { // edge.next();
-                continue; }
-
-            HEP_Edge* edge = heFaceP->edge[eIdx];
+            HEP_Edge* edge = heFace.edge[eIdx];
+            if (edge->converse_edge) continue; // already connected from the other side
 
             int face2 = face.connected_face_index[eIdx]; // connected_face X is connected via vertex X and vertex X+1
 
@@ -276,42 +236,19 @@ HEP_Mesh::HEP_Mesh(FVMesh& mesh)
 
             for (int e2 = 0; e2 < 3; e2++)
             {
-                if (&vertices[  mesh.faces[face2].vertex_index[e2]  ] == edge->next_edge->from_vert)
+                if (faces[face2].edge[e2]->from_vert == edge->next_edge->from_vert)
                 {
-
-                    faces[face2].edge[e2]->converse_edge = edge;
-                    edge->converse_edge = faces[face2].edge[e2];
-                    faceEdgeIsConnected[face2][e2] = true; // the other way around doesn't have to be set; we will not pass the same edge twice
+                    connectEdgesConverse(edge, faces[face2].edge[e2]);
                     break;
                 }
-                if (e2 == 2) std::cerr << "Couldn't find converse of edge !!!!!" << std::endl;
+                if (e2 == 2) atlas::logError("Couldn't find converse of edge!\n");
             }
-
-
-            //edge = edge.next();
-        } //while (edge != edgeStart)
+        }
 
     }
 
     HEP_MESH_DEBUG_DO(
-        std::cerr <<  "============================" << std::endl;
-        std::cerr <<  "mesh: " << std::endl;
-        std::cerr <<  "faces: "+ std::to_string(mesh.faces.size()) << std::endl;
-        std::cerr << "vertices: "+std::to_string(mesh.vertices.size()) << std::endl;
-
-
-        std::cerr <<  "============================" << std::endl;
-        std::cerr <<  ("half-edge mesh: ") << std::endl;
-        std::cerr <<  ("faces: ") << std::endl;
-        for (int f = 0; f < faces.size(); f++)
-            std::cerr << f << " " <<(faces[f].toString()) << std::endl;
-        std::cerr << ("edges: ") << std::endl;
-        for (int f = 0; f < edges.size(); f++)
-            std::cerr << f << " " <<(edges[f].toString()) << std::endl;
-        std::cerr << ("vertices: ") << std::endl;
-        for (int f = 0; f < vertices.size(); f++)
-            std::cerr << f << " " <<(vertices[f].toString()) << std::endl;
-        std::cerr <<  "============================" << std::endl;
+        debugOutputWholeMesh();
      )
 
 }
@@ -338,4 +275,47 @@ void HEP_Mesh::debugOutputWholeMesh()
 }
 
 
+void HEP_Mesh::testPerformance(FVMesh& mesh)
+{
+    TimeKeeper timeKeeper;
+
+    HE_Mesh heMesh(mesh);
+    std::cerr << "HE_Mesh construction: " << timeKeeper.restart() << "s" << std::endl;
+
+    HEP_Mesh hepMesh(mesh);
+    std::cerr << "HEP_Mesh construction: " << timeKeeper.restart() << "s" << std::endl;
+
+    // walk around each vertex, which is the basic operation of the topology edits
+    int64_t heSum = 0;
+    for (int v = 0; v < heMesh.vertices.size(); v++)
+    {
+        int first = heMesh.vertices[v].someEdge_idx;
+        if (first < 0) continue; // vertex without faces
+        int e = first;
+        do
+        {
+            heSum += heMesh.vertices[heMesh.edges[heMesh.edges[e].next_edge_idx].from_vert_idx].p.z;
+            e = heMesh.edges[heMesh.edges[e].converse_edge_idx].next_edge_idx;
+        } while (e != first);
+    }
+    std::cerr << "HE_Mesh vertex walk: " << timeKeeper.restart() << "s" << std::endl;
 
+    int64_t hepSum = 0;
+    for (HEP_Vertex& v : hepMesh.vertices)
+    {
+        HEP_Edge* first = v.someEdge;
+        if (!first) continue; // vertex without faces
+        HEP_Edge* e = first;
+        do
+        {
+            hepSum += e->next_edge->from_vert->p.z;
+            e = e->converse_edge->next_edge;
+        } while (e != first);
+    }
+    std::cerr << "HEP_Mesh vertex walk: " << timeKeeper.restart() << "s" << std::endl;
+
+    if (heSum != hepSum)
+    {
+        atlas::logError("HE_Mesh and HEP_Mesh differ!\n");
+    }
+}
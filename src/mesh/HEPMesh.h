@@ -8,6 +8,8 @@
 
 #include "HalfEdgeMesh.h"
 
+#include "../utils/BlockPool.h"
+
 #include "HEPMesh.h"
 #include "HEPMeshFace.h"
 #include "HEPMeshEdge.h"
@@ -56,8 +58,12 @@ The converse of a half-edge of such an edge belonging to face F is given by the
 As such we should keep in mind that when starting from some half-edge connected to a vertex, we cannot be guaranteed to be able to traverse all connected edges just by using the operations getNext() and getConverse()!
 Walking along the surface of a model means walking along the outside of the model (as opposed to the inside).
 
+In contrast to the HE_Mesh, the elements refer to each other by pointer rather than by index.
+All elements are therefore stored in BlockPools, which never move their elements when growing.
+For the same reason a HEP_Mesh cannot be copied.
+
 */
-class HEP_Mesh : public Mesh<HEP_Vertex, HEP_VertexHandle, HEP_Face, HEP_FaceHandle> // inherits from mesh interface
+class HEP_Mesh : public Mesh<HEP_Vertex, HEP_VertexHandle, HEP_Face, HEP_FaceHandle, BlockPool<HEP_Vertex>, BlockPool<HEP_Face>> // inherits from mesh interface
 {
     public:
         typedef HEP_Vertex Vertex;
@@ -66,7 +72,7 @@ class HEP_Mesh : public Mesh<HEP_Vertex, HEP_VertexHandle, HEP_Face, HEP_FaceHan
 
         //std::vector<HEP_Vertex> vertices;
         //std::vector<HEP_Face> faces;
-        std::vector<HEP_Edge> edges;
+        BlockPool<HEP_Edge> edges;
 
         HEP_Mesh(FVMesh& mesh);
         HEP_Mesh(HE_Mesh& mesh);
@@ -96,6 +102,11 @@ class HEP_Mesh : public Mesh<HEP_Vertex, HEP_VertexHandle, HEP_Face, HEP_FaceHan
 
 
         void debugOutputWholeMesh();
+
+        /*!
+        Compare construction and traversal times of a HE_Mesh and a HEP_Mesh built from the same mesh, and print them to std::cerr.
+        */
+        static void testPerformance(FVMesh& mesh);
     protected:
     private:
         //int findIndexOfVertex(Point3& v); //!< find index of vertex close to the given point, or create a new vertex and return its index.
@@ -27,6 +27,8 @@ class HEP_Edge {
         HEP_Edge(HEP_Vertex* from_vert, HEP_Face* face)
         : from_vert(from_vert)
         //, to_vert(to_vert)
+        , next_edge(nullptr)
+        , converse_edge(nullptr)
         , face(face)
         {};
 
@@ -41,7 +41,7 @@ class HEP_Face : public MeshFace<HEP_Vertex>
 
 
 
-struct HEP_FaceHandle : public MeshFaceHandle<HEP_Vertex, HEP_VertexHandle, HEP_Face, HEP_Mesh>
+struct HEP_FaceHandle : public MeshFaceHandle<HEP_FaceHandle, HEP_Vertex, HEP_VertexHandle, HEP_Face, HEP_Mesh>
 {
     HEP_Face& f;
     HEP_Face& face() { return f; };
@@ -30,7 +30,7 @@ Point HEP_VertexHandle::p() { return vertex().p; };
 
 bool HEP_VertexHandle::isManifold(FVMeshVertexHandle& correspondingFVMeshVertex)
 {
-    if (correspondingFVMeshVertex.vertex().connected_faces.size() < 6) return true;
+    if (correspondingFVMeshVertex.connectedFaces().size() < 6) return true;
     // for a correct model, the minimal amount of faces sharing a vertex in a 2D manifold is 3
     // and we need at least 6 faces to connect 2 such manifolds, leading to a non-manifold vertex
 
@@ -42,12 +42,12 @@ bool HEP_VertexHandle::isManifold(FVMeshVertexHandle& correspondingFVMeshVertex)
 void HEP_VertexHandle::getConnectedEdgeGroups(FVMeshVertexHandle& correspondingFVMeshVertex, std::vector<std::vector<HEP_EdgeHandle>> & result)
 {
     HEP_MESH_DEBUG_PRINTLN(" getConnectedEdgeGroups ");
-    std::vector<uint32_t>& connected_faces_idx = correspondingFVMeshVertex.vertex().connected_faces;
+    FVMeshConnectedFaces connected_faces_idx = correspondingFVMeshVertex.connectedFaces();
     std::set<HEP_Face*> checkedFaces;
 
     for (int f = 0; f < connected_faces_idx.size(); f++)
     {
-        if (checkedFaces.find(&m->faces[f]) != checkedFaces.end()) continue; // continue when found
+        if (checkedFaces.find(&m->faces[connected_faces_idx[f]]) != checkedFaces.end()) continue; // continue when found
 
         std::vector<HEP_EdgeHandle> currentGroup;
 
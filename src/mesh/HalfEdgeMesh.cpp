@@ -5,7 +5,10 @@
 
 #include "polyhedra.h" // for in testMakeManifold
 
-#include "../settings.h" // MAX_EDGES_PER_VERTEX
+#include "../settings.h" // MAX_EDGES_PER_VERTEX, MELD_DISTANCE
+#include "../utils/parallel.h"
+
+#include "EdgeConnectivity.h"
 
 #include "../MACROS.h" // debug
 
@@ -25,6 +28,8 @@
 
 
 #include <iostream>
+#include <atomic>
+#include <algorithm> // min
 
 
 
@@ -71,6 +76,8 @@ int HE_Mesh::createConverse(int e_idx)
 
 int HE_Mesh::createFace(int v0_idx, int v1_idx, int v2_idx)
 {
+        invalidateFaceAttributes();
+
         HE_Face f;
         int f_idx = faces.size();
 
@@ -140,6 +147,11 @@ int HE_Mesh::createFace(int v0_idx, int v1_idx, int v2_idx)
 
 BoundingBox HE_Mesh::computeBbox()
 {
+    if (vertices.size() == 0)
+    {
+        bbox = BoundingBox(0,0,0,0,0,0);
+        return bbox;
+    }
     BoundingBox ret(vertices[0].p, vertices[0].p);
     for (HE_Vertex& v : vertices)
     {
@@ -166,119 +178,230 @@ BoundingBox HE_Mesh::computeBbox()
 //};
 Point3 HE_Mesh::getNormal(int f) //const
 {
+    if (hasFaceAttributes())
+        return face_attributes.normal(f).toPoint3();
     Point p0 = HE_FaceHandle(*this, f).p0();
     Point p1 = HE_FaceHandle(*this, f).p1();
     Point p2 = HE_FaceHandle(*this, f).p2();
     return FPoint3::cross(p1-p0, p2-p0).normalized().toPoint3();
 };
 
-void HE_Mesh::addFace(Point& p0, Point& p1, Point& p2)
-{} // TODO
-void HE_Mesh::finish()
-{} // TODO
+const HE_FaceAttributes& HE_Mesh::getFaceAttributes()
+{
+    if (!hasFaceAttributes())
+        face_attributes.compute(*this);
+    return face_attributes;
+}
 
-void HE_Mesh::clear()
+void HE_Mesh::addFace(Point& p0, Point& p1, Point& p2)
 {
-    vertices.clear();
-    edges.clear();
-    faces.clear();
+    int vi0 = findIndexOfVertex(p0);
+    int vi1 = findIndexOfVertex(p1);
+    int vi2 = findIndexOfVertex(p2);
+    if (vi0 == vi1 || vi1 == vi2 || vi0 == vi2) return; // the face has two vertices which get assigned the same location. Don't add the face.
+
+    createFace(vi0, vi1, vi2);
 }
 
-HE_Mesh::~HE_Mesh()
+void HE_Mesh::addFaces(const float* tris, size_t n, const FMatrix3x3& matrix)
 {
-    clear();
+    std::vector<Point3> points(n * 3);
+    parallelFor(n * 3, [&](size_t i)
+        {
+            const float* v = tris + i * 3;
+            points[i] = matrix.apply(FPoint3(v[0], v[1], v[2]));
+        });
+    addFaces(points.data(), n);
 }
 
-HE_Mesh::HE_Mesh(FVMesh& mesh)
-: Mesh(nullptr)
+void HE_Mesh::addFaces(const Point3* tri_vertices, size_t n)
 {
-    for (int vIdx = 0 ; vIdx < mesh.vertices.size() ; vIdx++)
+    size_t n_points = n * 3;
+    reserve(n);
+
+    std::vector<uint32_t> first_occurrence;
+    VertexHashTable::findFirstOccurrences(tri_vertices, n_points, first_occurrence);
+
+    std::vector<int> vertex_idx(n_points);
+    for (size_t i = 0; i < n_points; i++)
     {
-        vertices.push_back(HE_Vertex(mesh.vertices[vIdx].p, -1));
+        if (first_occurrence[i] == i)
+            vertex_idx[i] = findIndexOfVertex(tri_vertices[i]);
+        else
+            vertex_idx[i] = vertex_idx[first_occurrence[i]];
     }
 
-    for (int fIdx = 0 ; fIdx < mesh.faces.size() ; fIdx++)
+    for (size_t f = 0; f < n; f++)
     {
-        FVMeshFace& fvFace = mesh.faces[fIdx];
-        HE_Face heFace;
-        HE_Edge edge0(fvFace.vertex_index[0], fIdx); // vertices in face are ordered counter-clockwise
-        HE_Edge edge1(fvFace.vertex_index[1], fIdx);
-        HE_Edge edge2(fvFace.vertex_index[2], fIdx);
+        int vi0 = vertex_idx[f * 3], vi1 = vertex_idx[f * 3 + 1], vi2 = vertex_idx[f * 3 + 2];
+        if (vi0 == vi1 || vi1 == vi2 || vi0 == vi2) continue; // the face has two vertices which get assigned the same location. Don't add the face.
+        createFace(vi0, vi1, vi2);
+    }
+}
 
-        int newEdgeIndex = edges.size();
+void HE_Mesh::reserve(size_t n_faces)
+{
+    size_t n_vertices = vertices.size() + n_faces / 2 + 2; // a closed manifold has about half as many vertices as faces
+    faces.reserve(faces.size() + n_faces);
+    edges.reserve(edges.size() + n_faces * 3);
+    vertices.reserve(n_vertices);
+    vertex_hash_table.reserve(n_vertices);
+}
 
-        vertices[ fvFace.vertex_index[0] ].someEdge_idx = newEdgeIndex+0; // overwrites existing data, if present
-        vertices[ fvFace.vertex_index[1] ].someEdge_idx = newEdgeIndex+1;
-        vertices[ fvFace.vertex_index[2] ].someEdge_idx = newEdgeIndex+2;
+int HE_Mesh::findIndexOfVertex(const Point3& v)
+{
+    int idx = vertex_hash_table.find(v, [this](uint32_t vertex_idx) { return vertices[vertex_idx].p; });
+    if (idx >= 0)
+        return idx;
 
-        edge0.next_edge_idx = newEdgeIndex+1;
-        edge1.next_edge_idx = newEdgeIndex+2;
-        edge2.next_edge_idx = newEdgeIndex+0;
+    vertex_hash_table.insert(v, vertices.size());
+    return createVertex(v);
+}
 
-        edges.push_back(edge0);
-        edges.push_back(edge1);
-        edges.push_back(edge2);
+void HE_Mesh::finish()
+{
+    // the vertex_hash_table is no longer needed from this point on and uses quite a bit of memory.
+    vertex_hash_table.clear();
 
-        heFace.edge_idx[0] = newEdgeIndex+0;
-        heFace.edge_idx[1] = newEdgeIndex+1;
-        heFace.edge_idx[2] = newEdgeIndex+2;
-        faces.push_back(heFace);
+    computeBbox();
 
-    }
+    std::vector<int> connected_face_edge;
+    EdgeConnectivity::connectFaceEdges(faces.size()
+        , [this](size_t f, int i) { return edges[faces[f].edge_idx[i]].from_vert_idx; }
+        , [this](int v) { return vertices[v].p; }
+        , connected_face_edge);
+    connectConverseEdges(connected_face_edge);
+}
 
+void HE_Mesh::connectConverseEdges(const std::vector<int>& connected_face_edge)
+{
+    std::vector<bool> face_edge_is_connected(connected_face_edge.size(), false);
+    for (size_t face_edge = 0; face_edge < connected_face_edge.size(); face_edge++)
+    {
+        if (face_edge_is_connected[face_edge])
+            continue;
+        int edge_idx = faces[face_edge / 3].edge_idx[face_edge % 3];
+        int other = connected_face_edge[face_edge];
+        if (other < 0)
+        {
+            edges[edge_idx].converse_edge_idx = -1;
+            continue;
+        }
+        connectEdgesConverse(edge_idx, faces[other / 3].edge_idx[other % 3]);
+        face_edge_is_connected[other] = true; // the other way around doesn't have to be set; we will not pass the same edge twice
+    }
+}
 
-    // connect half-edges:
+void HE_Mesh::clear()
+{
+    vertices.clear();
+    edges.clear();
+    faces.clear();
+    vertex_hash_table.clear();
+    invalidateFaceAttributes();
+}
 
-    bool faceEdgeIsConnected[mesh.faces.size()][3] = {}; // initialize all as false
+HE_Mesh::HE_Mesh(SettingsBase* parent)
+: Mesh(parent)
+, vertex_hash_table(MELD_DISTANCE) // same meld distance as the FVMesh
+{
+}
 
+HE_Mesh::HE_Mesh(const HE_Mesh& other)
+: Mesh(other)
+, edges(other.edges)
+, vertex_hash_table(other.vertex_hash_table)
+{
+}
 
-    // for each edge of each face : if it doesn't have a converse then find the converse in the edges of the opposite face
-    for (int fIdx = 0 ; fIdx < mesh.faces.size() ; fIdx++)
-    {
-        FVMeshFace& fvFace = mesh.faces[fIdx];
-        //FVMeshFaceHandle fh(mesh, fIdx);
+HE_Mesh& HE_Mesh::operator=(const HE_Mesh& other)
+{
+    Mesh::operator=(other);
+    edges = other.edges;
+    vertex_hash_table = other.vertex_hash_table;
+    invalidateFaceAttributes();
+    return *this;
+}
 
-        HE_FaceHandle fnew(*this, fIdx); // face index on FVMesh corresponds to index in HE_Mesh
+HE_Mesh::~HE_Mesh()
+{
+    clear();
+}
 
-//        HE_EdgeHandle edge = fnew.edge0();
-//        HE_EdgeHandle edgeStart = edge;
-//        do //
-        for (int eIdx = 0; eIdx < 3; eIdx++)
-        {
-            if (faceEdgeIsConnected[fIdx][eIdx])
-                { // edge.next();
-                continue; }
+/*!
+All steps are independent per face (or per vertex), and are run in parallel, except for linking up the converse edges,
+which is a single linear pass using a bitset of the face edges already connected.
 
-            int edge_idx = faces[fIdx].edge_idx[eIdx];
-            HE_Edge& edge = edges[ edge_idx ];
-            int face2 = fvFace.connected_face_index[eIdx]; // connected_face X is connected via vertex X and vertex X+1
+Face \p f of the FVMesh becomes face \p f of the HE_Mesh, and its half-edges get indices 3f, 3f+1 and 3f+2.
+*/
+HE_Mesh::HE_Mesh(FVMesh& mesh)
+: Mesh(nullptr)
+, vertex_hash_table(MELD_DISTANCE)
+{
+    size_t n_faces = mesh.faces.size();
+    vertices.resize(mesh.vertices.size(), HE_Vertex(Point(0,0,0), -1));
+    faces.resize(n_faces);
+    edges.resize(n_faces * 3, HE_Edge(-1, -1));
 
-            if (face2 < 0)
+    parallelFor(vertices.size(), [&](size_t v)
+        {
+            vertices[v].p = mesh.vertices[v].p;
+            // the last face connected to the vertex provides its edge
+            FVMeshConnectedFaces connected_faces = mesh.getConnectedFaces(v);
+            if (connected_faces.size() > 0)
             {
-                atlas::logError("Incorrect model: disconnected faces. Support generation aborted.\n");
-                exit(1); // TODO: not exit, but continue without support!
+                int f = connected_faces[connected_faces.size() - 1];
+                for (int i = 0; i < 3; i++)
+                    if (mesh.faces[f].vertex_index[i] == int(v))
+                        vertices[v].someEdge_idx = f * 3 + i;
             }
+        });
 
-            for (int e2 = 0; e2 < 3; e2++)
+    // for each edge of each face : find the converse in the edges of the opposite face
+    std::vector<int> connected_face_edge(n_faces * 3);
+    std::atomic<bool> disconnected(false);
+    parallelFor(n_faces, [&](size_t fIdx)
+        {
+            FVMeshFace& fvFace = mesh.faces[fIdx];
+            int newEdgeIndex = fIdx * 3;
+            for (int eIdx = 0; eIdx < 3; eIdx++)
             {
-                if (mesh.faces[face2].vertex_index[e2] == edges[edge.next_edge_idx].from_vert_idx)
+                HE_Edge& edge = edges[newEdgeIndex + eIdx];
+                edge.from_vert_idx = fvFace.vertex_index[eIdx]; // vertices in face are ordered counter-clockwise
+                edge.face_idx = fIdx;
+                edge.next_edge_idx = newEdgeIndex + (eIdx + 1) % 3;
+                faces[fIdx].edge_idx[eIdx] = newEdgeIndex + eIdx;
+
+                int to_vert_idx = fvFace.vertex_index[(eIdx + 1) % 3];
+                int face2 = fvFace.connected_face_index[eIdx]; // connected_face X is connected via vertex X and vertex X+1
+                connected_face_edge[newEdgeIndex + eIdx] = -1;
+                if (face2 < 0)
+                {
+                    disconnected = true;
+                    continue;
+                }
+                for (int e2 = 0; e2 < 3; e2++)
                 {
-                    edges[ faces[face2].edge_idx[e2] ].converse_edge_idx = edge_idx;
-                    edge.converse_edge_idx = faces[face2].edge_idx[e2];
-                    faceEdgeIsConnected[face2][e2] = true; // the other way around doesn't have to be set; we will not pass the same edge twice
-                    break;
+                    if (mesh.faces[face2].vertex_index[e2] == to_vert_idx)
+                    {
+                        connected_face_edge[newEdgeIndex + eIdx] = face2 * 3 + e2;
+                        break;
+                    }
+                    if (e2 == 2) atlas::logError("Couldn't find converse of edge %i!!!!!\n", newEdgeIndex + eIdx);
                 }
-                if (e2 == 2) std::cerr << "Couldn't find converse of edge " << std::to_string(edge_idx) <<"!!!!!" << std::endl;
             }
+        });
 
-
-            //edge = edge.next();
-        } //while (edge != edgeStart)
-
+    if (disconnected)
+    {
+        atlas::logError("Incorrect model: disconnected faces. Support generation aborted.\n");
+        exit(1); // TODO: not exit, but continue without support!
     }
 
+    connectConverseEdges(connected_face_edge);
+
     HE_MESH_DEBUG_DO(
-        mesh.debugOutputWholeMesh();
+        debugOutputWholeMesh();
      )
 
 }
@@ -329,6 +452,7 @@ void HE_Mesh::makeManifold(FVMesh& correspondingFVMesh)
         //HE_MESH_DEBUG_SHOW(v);
         HE_VertexHandle(*this, v).splitWhenNonManifold(fvvh);
     }
+    invalidateFaceAttributes(); // splitting vertices moves them
 
 }
 
@@ -361,6 +485,80 @@ void HE_Mesh::testMakeManifold(PrintObject* model)
 }
 
 
+void HE_Mesh::test()
+{
+    std::cerr << " TEST building HE_Mesh directly and via FVMesh... " << std::endl;
+
+    // a closed box with n x n squares of 2 triangles on each side, with the corners of each triangle given separately
+    const int n = 8;
+    const spaceType size = 10000;
+    std::vector<Point3> tri_vertices;
+    for (int axis = 0; axis < 3; axis++)
+        for (int dir = 0; dir < 2; dir++)
+            for (int i = 0; i < n; i++)
+                for (int j = 0; j < n; j++)
+                {
+                    auto corner = [&](int di, int dj)
+                    {
+                        int32_t coords[3];
+                        coords[axis] = dir * size;
+                        coords[(axis + 1) % 3] = (i + di) * size / n;
+                        coords[(axis + 2) % 3] = (j + dj) * size / n;
+                        Point3 p(coords[0], coords[1], coords[2]);
+                        if ((i + j + di) % 3 == 0)
+                            p += Point3(MELD_DISTANCE / 3, 0, 0); // should be welded to the other corners at the same location
+                        return p;
+                    };
+                    Point3 square[4] = { corner(0, 0), corner(1, 0), corner(1, 1), corner(0, 1) };
+                    int order[6] = { 0, 1, 2, 0, 2, 3 }; // counter-clockwise seen from outside for dir = 1
+                    for (int k = 0; k < 6; k++)
+                        tri_vertices.push_back(square[(dir == 1)? order[k] : order[5 - k]]);
+                }
+    // a face which collapses when its vertices are welded
+    tri_vertices.push_back(Point3(size, size, size));
+    tri_vertices.push_back(Point3(size + 1, size, size));
+    tri_vertices.push_back(Point3(size, size + 1, size));
+
+    FVMesh fv_mesh(nullptr);
+    fv_mesh.addFaces(tri_vertices.data(), tri_vertices.size() / 3);
+    fv_mesh.finish();
+    HE_Mesh via_fv_mesh(fv_mesh);
+
+    HE_Mesh direct;
+    direct.addFaces(tri_vertices.data(), tri_vertices.size() / 3);
+    direct.finish();
+
+    int errors = 0;
+    auto check = [&errors](bool ok, const char* what, size_t idx)
+    {
+        if (!ok && errors++ < 10)
+            std::cerr << " mismatch in " << what << " " << idx << std::endl;
+    };
+    check(direct.vertices.size() == via_fv_mesh.vertices.size(), "vertex count", direct.vertices.size());
+    check(direct.edges.size() == via_fv_mesh.edges.size(), "edge count", direct.edges.size());
+    check(direct.faces.size() == via_fv_mesh.faces.size(), "face count", direct.faces.size());
+    for (size_t v = 0; v < std::min(direct.vertices.size(), via_fv_mesh.vertices.size()); v++)
+    {
+        check(direct.vertices[v].p == via_fv_mesh.vertices[v].p, "location of vertex", v);
+        check(direct.vertices[v].someEdge_idx == via_fv_mesh.vertices[v].someEdge_idx, "someEdge_idx of vertex", v);
+    }
+    for (size_t e = 0; e < std::min(direct.edges.size(), via_fv_mesh.edges.size()); e++)
+    {
+        const HE_Edge& a = direct.edges[e];
+        const HE_Edge& b = via_fv_mesh.edges[e];
+        check(a.from_vert_idx == b.from_vert_idx, "from_vert_idx of edge", e);
+        check(a.next_edge_idx == b.next_edge_idx, "next_edge_idx of edge", e);
+        check(a.converse_edge_idx == b.converse_edge_idx, "converse_edge_idx of edge", e);
+        check(a.converse_edge_idx >= 0 && direct.edges[a.converse_edge_idx].converse_edge_idx == int(e), "converse of the converse of edge", e);
+        check(a.face_idx == b.face_idx, "face_idx of edge", e);
+    }
+    for (size_t f = 0; f < std::min(direct.faces.size(), via_fv_mesh.faces.size()); f++)
+        for (int i = 0; i < 3; i++)
+            check(direct.faces[f].edge_idx[i] == via_fv_mesh.faces[f].edge_idx[i], "edge_idx of face", f);
+
+    std::cerr << " " << direct.faces.size() << " faces, " << direct.vertices.size() << " vertices: " << ((errors == 0)? "identical" : "DIFFERENT!") << std::endl;
+}
+
 void HE_Mesh::checkModel(std::vector<ModelProblem>& problems)
 {
     for (int f = 0; f < faces.size(); f++)
@@ -10,6 +10,11 @@
 #include "HalfEdgeMeshFace.h"
 #include "HalfEdgeMeshEdge.h"
 #include "HalfEdgeMeshVertex.h"
+#include "HalfEdgeMeshFaceAttributes.h"
+
+#include "VertexHashTable.h"
+
+#include <type_traits> // is_trivially_copyable
 
 
 class PrintObject;
@@ -57,6 +62,8 @@ The converse of a half-edge of such an edge belonging to face F is given by the
 As such we should keep in mind that when starting from some half-edge connected to a vertex, we cannot be guaranteed to be able to traverse all connected edges just by using the operations getNext() and getConverse()!
 Walking along the surface of a model means walking along the outside of the model (as opposed to the inside).
 
+A HE_Mesh can be converted from a finished FVMesh, or be built directly from a triangle soup with addFace(s) and finish(),
+which welds the vertices and connects the half-edges without an intermediate FVMesh.
 */
 class HE_Mesh : public Mesh<HE_Vertex, HE_VertexHandle, HE_Face, HE_FaceHandle> // inherits from mesh interface
 {
@@ -69,7 +76,11 @@ class HE_Mesh : public Mesh<HE_Vertex, HE_VertexHandle, HE_Face, HE_FaceHandle>
         std::vector<HE_Edge> edges;
 
         HE_Mesh(FVMesh& mesh);
-        HE_Mesh() : Mesh(nullptr) {};
+        HE_Mesh(SettingsBase* parent = nullptr); //!< an empty mesh, to be filled with addFace(s) and finish()
+        HE_Mesh(const HE_Mesh& other); //!< copies everything but the cached face attributes, since copies are often made in order to move their vertices
+        HE_Mesh(HE_Mesh&&) = default;
+        HE_Mesh& operator=(const HE_Mesh& other); //!< see HE_Mesh(const HE_Mesh&)
+        HE_Mesh& operator=(HE_Mesh&&) = default;
         virtual ~HE_Mesh();
 
 
@@ -87,6 +98,19 @@ class HE_Mesh : public Mesh<HE_Vertex, HE_VertexHandle, HE_Face, HE_FaceHandle>
         //Point3 getNormal(HE_Face& face) const;
         Point3 getNormal(int f_idx);// const;
 
+        /*!
+        The cached normals, planes and bounding boxes of all faces, computed in one parallel pass when the cache isn't valid.
+
+        The cache is invalidated by the member functions which change the faces, but not by moving vertices directly:
+        call invalidateFaceAttributes() after changing vertex locations.
+        Copies of the mesh start without the cache.
+        Not thread-safe when the cache has to be computed; call it before sharing the mesh between threads.
+        */
+        const HE_FaceAttributes& getFaceAttributes();
+        //! whether the cached face attributes are up to date; when they aren't, the face handles compute normals and bounding boxes from scratch
+        bool hasFaceAttributes() const { return face_attributes.size() == faces.size(); }
+        void invalidateFaceAttributes() { face_attributes.clear(); }
+
         void connectEdgesPrevNext(int prev, int next);
         void connectEdgesConverse(int e1, int e2);
 
@@ -98,9 +122,12 @@ class HE_Mesh : public Mesh<HE_Vertex, HE_VertexHandle, HE_Face, HE_FaceHandle>
         BoundingBox computeBbox();
 
 
-        void addFace(Point& p0, Point& p1, Point& p2) ; //!< add a face to the mesh without settings it's traits.
+        void addFace(Point& p0, Point& p1, Point& p2) ; //!< add a face to the mesh without settings it's traits: the vertices are welded, but the converse edges are not yet set.
+        void addFaces(const Point3* tri_vertices, size_t n); //!< add \p n faces at once, given as 3 consecutive vertices per face; same result as calling addFace for each
+        void addFaces(const float* tris, size_t n, const FMatrix3x3& matrix); //!< add \p n faces given as 9 floats (in mm) per face, transformed by \p matrix
+        void reserve(size_t n_faces); //!< prepare for adding \p n_faces more faces
         void clear() ; //!< clears all data
-        void finish() ; //!< complete the model : compute all traits.
+        void finish() ; //!< complete the model : compute all traits; connects the converse edges and computes the bounding box.
 
 
 
@@ -113,14 +140,80 @@ class HE_Mesh : public Mesh<HE_Vertex, HE_VertexHandle, HE_Face, HE_FaceHandle>
         void makeManifold(FVMesh& correspondingFVMesh);
 
         static void testMakeManifold(PrintObject* model);
+        static void test(); //!< checks that building a mesh with addFaces and finish() gives the same mesh as converting an FVMesh
 
         HE_FaceHandle getFaceWithPoints(HE_VertexHandle v1, HE_VertexHandle v2, HE_FaceHandle notFace);
 
     protected:
     private:
-        //int findIndexOfVertex(Point3& v); //!< find index of vertex close to the given point, or create a new vertex and return its index.
+        HE_FaceAttributes face_attributes; //!< see getFaceAttributes
+
+        //! The vertex_hash_table stores a index reference of each vertex for the cell of that location, while adding faces. Cleared on finish().
+        VertexHashTable vertex_hash_table;
+
+        int findIndexOfVertex(const Point3& v); //!< find index of vertex close to the given point, or create a new vertex and return its index.
+
+        /*!
+        Set the converse of each half-edge, given for each face edge (face index * 3 + edge index) the face edge it's connected to.
+        When the connections aren't symmetric (which can only happen at non-manifold edges) the first face edge to claim another wins.
+        */
+        void connectConverseEdges(const std::vector<int>& connected_face_edge);
 
 };
 
 
+/*
+ The handle accessors below need the complete HE_Mesh, but are defined inline so that walking over the mesh compiles down to plain index lookups.
+*/
+
+inline HE_Edge& HE_EdgeHandle::edge() { return m->edges[idx]; }
+inline HE_EdgeHandle HE_EdgeHandle::next() { return HE_EdgeHandle(*m, m->edges[idx].next_edge_idx); }
+inline HE_EdgeHandle HE_EdgeHandle::converse() { return HE_EdgeHandle(*m, m->edges[idx].converse_edge_idx); }
+inline HE_VertexHandle HE_EdgeHandle::from_vert() { return HE_VertexHandle(*m, m->edges[idx].from_vert_idx); }
+inline HE_VertexHandle HE_EdgeHandle::to_vert() { return next().from_vert(); }
+inline HE_VertexHandle HE_EdgeHandle::v0() { return from_vert(); }
+inline HE_VertexHandle HE_EdgeHandle::v1() { return to_vert(); }
+inline HE_FaceHandle HE_EdgeHandle::face() { return HE_FaceHandle(*m, m->edges[idx].face_idx); }
+inline Point& HE_EdgeHandle::p0() { return m->vertices[m->edges[idx].from_vert_idx].p; }
+inline Point& HE_EdgeHandle::p1() { return to_vert().vertex().p; }
+inline void HE_EdgeHandle::set(HE_EdgeHandle& b) { idx = b.idx; m = b.m; }
+
+inline HE_EdgeHandle HE_FaceHandle::edge0() const { return HE_EdgeHandle(*m, m->faces[idx].edge_idx[0]); }
+inline HE_EdgeHandle HE_FaceHandle::edge1() const { return HE_EdgeHandle(*m, m->faces[idx].edge_idx[1]); }
+inline HE_EdgeHandle HE_FaceHandle::edge2() const { return HE_EdgeHandle(*m, m->faces[idx].edge_idx[2]); }
+inline HE_VertexHandle HE_FaceHandle::v0() const { return edge0().from_vert(); }
+inline HE_VertexHandle HE_FaceHandle::v1() const { return edge1().from_vert(); }
+inline HE_VertexHandle HE_FaceHandle::v2() const { return edge2().from_vert(); }
+inline FPoint HE_FaceHandle::normal() const
+{
+    if (m->hasFaceAttributes()) return m->getFaceAttributes().normal(idx);
+    return MeshFaceHandle::normal();
+}
+inline void HE_FaceHandle::plane(FPoint& normal, float& offset) const
+{
+    if (m->hasFaceAttributes())
+    {
+        const HE_FaceAttributes& attributes = m->getFaceAttributes();
+        normal = attributes.normal(idx);
+        offset = attributes.offset[idx];
+    }
+    else
+        HE_FaceAttributes::computePlane(FPoint(p0()), FPoint(p1()), FPoint(p2()), normal, offset);
+}
+inline BoundingBox HE_FaceHandle::bbox() const
+{
+    if (m->hasFaceAttributes()) return m->getFaceAttributes().bboxes[idx];
+    return MeshFaceHandle::bbox();
+}
+
+inline HE_Vertex& HE_VertexHandle::vertex() { return m->vertices[idx]; }
+inline HE_EdgeHandle HE_VertexHandle::someEdge() { return HE_EdgeHandle(*m, m->vertices[idx].someEdge_idx); }
+inline Point& HE_VertexHandle::p() { return m->vertices[idx].p; }
+inline Point HE_VertexHandle::p_const() const { return m->vertices[idx].p; }
+
+static_assert(std::is_trivially_copyable<HE_EdgeHandle>::value, "HE_EdgeHandle should be a plain (mesh, index) pair");
+static_assert(std::is_trivially_copyable<HE_FaceHandle>::value, "HE_FaceHandle should be a plain (mesh, index) pair");
+static_assert(std::is_trivially_copyable<HE_VertexHandle>::value, "HE_VertexHandle should be a plain (mesh, index) pair");
+
+
 #endif // HALFEDGEMESH_H
@@ -69,7 +69,6 @@ struct HE_EdgeHandle
     };
 
     void set(HE_EdgeHandle& b);
-    HE_EdgeHandle& operator =(const HE_EdgeHandle& other);
 };
 
 namespace std {
@@ -42,7 +42,7 @@ class HE_Face : public MeshFace<HE_Vertex>
 
 
 
-struct HE_FaceHandle : public MeshFaceHandle<HE_Vertex, HE_VertexHandle, HE_Face, HE_Mesh>
+struct HE_FaceHandle : public MeshFaceHandle<HE_FaceHandle, HE_Vertex, HE_VertexHandle, HE_Face, HE_Mesh>
 {
     HE_FaceHandle(HE_Mesh& m, int idx) : MeshFaceHandle(m, idx) {};
 
@@ -56,6 +56,11 @@ struct HE_FaceHandle : public MeshFaceHandle<HE_Vertex, HE_VertexHandle, HE_Face
 
     HE_EdgeHandle getEdgeFrom(HE_VertexHandle& v) const ;
 
+    // the versions below use the face attributes cached in the mesh when they are valid (see HE_Mesh::getFaceAttributes)
+    FPoint normal() const ; //!< the unit normal
+    void plane(FPoint& normal, float& offset) const ; //!< the unit normal and the d in normal . p + d = 0 for the points p on the plane of the face
+    BoundingBox bbox() const ;
+
 };
 
 namespace std {
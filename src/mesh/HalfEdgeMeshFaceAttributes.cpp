@@ -0,0 +1,102 @@
+#include "HalfEdgeMeshFaceAttributes.h"
+
+#include <algorithm> // max
+#include <math.h> // fabs, sqrt
+#include <limits> // epsilon
+
+#include "HalfEdgeMesh.h"
+
+#include "../utils/parallel.h"
+
+void HE_FaceAttributes::compute(const HE_Mesh& mesh)
+{
+    size_t n = mesh.faces.size();
+    for (int i = 0; i < 3; i++)
+    {
+        x[i].resize(n);
+        y[i].resize(n);
+        z[i].resize(n);
+    }
+    normal_x.resize(n);
+    normal_y.resize(n);
+    normal_z.resize(n);
+    offset.resize(n);
+    normal_error.resize(n);
+    bboxes.resize(n);
+    parallelFor(n, [&](size_t f)
+        {
+            const Point3* p[3];
+            FPoint3 fp[3];
+            for (int i = 0; i < 3; i++)
+            {
+                p[i] = &mesh.vertices[mesh.edges[mesh.faces[f].edge_idx[i]].from_vert_idx].p;
+                fp[i] = FPoint3(*p[i]);
+                x[i][f] = fp[i].x;
+                y[i][f] = fp[i].y;
+                z[i][f] = fp[i].z;
+            }
+            FPoint3 normal;
+            computePlane(fp[0], fp[1], fp[2], normal, offset[f]);
+            normal_x[f] = normal.x;
+            normal_y[f] = normal.y;
+            normal_z[f] = normal.z;
+            normal_error[f] = normalError(fp[0], fp[1], fp[2]);
+            bboxes[f] = BoundingBox(*p[0], *p[1]) + *p[2];
+        });
+
+    max_coord = 0;
+    for (const HE_Vertex& v : mesh.vertices)
+    {
+        FPoint3 p(v.p);
+        max_coord = std::max(max_coord, std::max(fabsf(p.x), std::max(fabsf(p.y), fabsf(p.z))));
+    }
+}
+
+void HE_FaceAttributes::clear()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        x[i].clear();
+        y[i].clear();
+        z[i].clear();
+    }
+    normal_x.clear();
+    normal_y.clear();
+    normal_z.clear();
+    offset.clear();
+    normal_error.clear();
+    bboxes.clear();
+    max_coord = 0;
+}
+
+/*!
+The computed normal is the float cross product of the float edges of the rounded vertices. Compared to the exact cross product of the exact edges:
+- each vertex coordinate is rounded to floats, so each edge is off by at most 2 * sqrt(3) * eps * (the largest coordinate),
+- subtracting the vertices adds an error of eps times the length of the edge,
+- the cross product adds at most 4 * eps * |e1| * |e2|.
+
+Normalizing two vectors which lie E apart moves them at most 2 * E / |exact vector| apart, and rounding the division adds a few eps more.
+*/
+float HE_FaceAttributes::normalError(const FPoint3& a, const FPoint3& b, const FPoint3& c)
+{
+    const double eps = std::numeric_limits<float>::epsilon() * .5; // the relative rounding error of floats
+    double e1[3] = { double(b.x) - a.x, double(b.y) - a.y, double(b.z) - a.z }; // exact
+    double e2[3] = { double(c.x) - a.x, double(c.y) - a.y, double(c.z) - a.z };
+    double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    double size1 = sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
+    double size2 = sqrt(e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2]);
+    double size_n = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    double max_coord = 0;
+    const FPoint3* vertices[3] = { &a, &b, &c };
+    for (const FPoint3* v : vertices)
+    {
+        max_coord = std::max(max_coord, double(std::max(fabsf(v->x), std::max(fabsf(v->y), fabsf(v->z)))));
+    }
+
+    double vertex_error = 2 * sqrt(3.) * eps * max_coord;
+    double edge_error1 = vertex_error + eps * size1;
+    double edge_error2 = vertex_error + eps * size2;
+    double cross_error = (4 * eps * size1 * size2 + edge_error1 * size2 + size1 * edge_error2 + edge_error1 * edge_error2) * 1.01; // rounded up, also for the roundings in computing the sizes above
+    if (cross_error * 2 >= size_n) return 2; // the normal may point anywhere; unit vectors never lie further apart
+    return float((2 * cross_error / (size_n - cross_error) + 8 * eps) * 1.01);
+}
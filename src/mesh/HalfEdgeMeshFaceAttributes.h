@@ -0,0 +1,67 @@
+#ifndef HALFEDGEMESHFACEATTRIBUTES_H
+#define HALFEDGEMESHFACEATTRIBUTES_H
+
+#include <vector>
+
+#include "../Kernel.h"
+#include "../BoundingBox.h"
+#include "../utils/floatpoint.h" // FPoint3
+
+class HE_Mesh;
+
+/*!
+The attributes of all faces of an HE_Mesh which only depend on the locations of their vertices, stored as one array per field.
+
+This is the cache kept by HE_Mesh::getFaceAttributes, shared by everything that needs face normals, planes or bounding boxes:
+the face handles, the support classification, the triangle-triangle intersection and the boolean operations.
+
+Coordinates and planes are in the float units (mm) of FPoint3.
+The normal and offset are computed in the same way as HE_FaceHandle::plane computes them without the cache, so using the cache doesn't change any result.
+They are rounded: the triangle-triangle intersection decides the sides of the planes exactly (see Orient3dPlane),
+so filters which have to agree with those sides should take normal_error into account.
+*/
+class HE_FaceAttributes
+{
+public:
+    std::vector<float> x[3]; //!< x coordinate of the i-th vertex of each face
+    std::vector<float> y[3]; //!< y coordinate of the i-th vertex of each face
+    std::vector<float> z[3]; //!< z coordinate of the i-th vertex of each face
+    std::vector<float> normal_x; //!< x of the unit normal of each face
+    std::vector<float> normal_y; //!< y of the unit normal of each face
+    std::vector<float> normal_z; //!< z of the unit normal of each face
+    std::vector<float> offset; //!< the d in normal . p + d = 0 for each point p on the plane of each face
+    std::vector<float> normal_error; //!< a bound on the distance between the unit normal of each face and the exact unit normal of its integer vertices (see normalError)
+    std::vector<BoundingBox> bboxes; //!< the bounding box of each face, in the integer coordinates of the mesh
+    float max_coord; //!< the largest absolute coordinate of all vertices; bounds the rounding errors of plane side tests
+
+    HE_FaceAttributes() : max_coord(0) {};
+
+    size_t size() const { return offset.size(); }; //!< the number of faces
+
+    void compute(const HE_Mesh& mesh); //!< (re)compute the attributes of all faces of \p mesh in one parallel pass
+    void clear(); //!< clears all data
+
+    FPoint3 normal(int f) const { return FPoint3(normal_x[f], normal_y[f], normal_z[f]); };
+
+    /*!
+    Compute the plane of the triangle \p a, \p b, \p c from scratch, the same way as compute(.) does.
+    \param normal output: the unit normal
+    \param offset output: the d in normal . p + d = 0
+    */
+    static void computePlane(const FPoint3& a, const FPoint3& b, const FPoint3& c, FPoint3& normal, float& offset)
+    {
+        normal = (b - a).cross(c - a).normalized();
+        offset = normal.dot(a) * -1;
+    };
+
+    /*!
+    A bound on the distance between the unit normal computed by computePlane(.) from \p a, \p b and \p c
+    and the exact unit normal of the triangle through the integer points they were rounded from.
+
+    The bound is about eps * |b - a| * |c - a| / |(b - a) x (c - a)|, plus the rounding of the vertices relative to the size of the normal,
+    so it is large for thin triangles. It is 2 when the rounded normal may point in any direction.
+    */
+    static float normalError(const FPoint3& a, const FPoint3& b, const FPoint3& c);
+};
+
+#endif // HALFEDGEMESHFACEATTRIBUTES_H
@@ -0,0 +1,52 @@
+#include "HalfEdgeMeshSoA.h"
+
+#include "HalfEdgeMesh.h"
+
+#include "../utils/parallel.h"
+
+HE_MeshSoA::HE_MeshSoA(const HE_Mesh& mesh)
+: vertex_x(mesh.vertices.size())
+, vertex_y(mesh.vertices.size())
+, vertex_z(mesh.vertices.size())
+, vertex_some_edge(mesh.vertices.size())
+, edge_from_vert(mesh.edges.size())
+, edge_next(mesh.edges.size())
+, edge_converse(mesh.edges.size())
+, edge_face(mesh.edges.size())
+, face_edge(mesh.faces.size() * 3)
+{
+    parallelFor(mesh.vertices.size(), [&](size_t v)
+        {
+            const HE_Vertex& vertex = mesh.vertices[v];
+            vertex_x[v] = vertex.p.x;
+            vertex_y[v] = vertex.p.y;
+            vertex_z[v] = vertex.p.z;
+            vertex_some_edge[v] = vertex.someEdge_idx;
+        });
+    parallelFor(mesh.edges.size(), [&](size_t e)
+        {
+            const HE_Edge& edge = mesh.edges[e];
+            edge_from_vert[e] = edge.from_vert_idx;
+            edge_next[e] = edge.next_edge_idx;
+            edge_converse[e] = edge.converse_edge_idx;
+            edge_face[e] = edge.face_idx;
+        });
+    parallelFor(mesh.faces.size(), [&](size_t f)
+        {
+            for (int i = 0; i < 3; i++)
+                face_edge[3 * f + i] = mesh.faces[f].edge_idx[i];
+        });
+}
+
+void HE_MeshSoA::clear()
+{
+    vertex_x.clear();
+    vertex_y.clear();
+    vertex_z.clear();
+    vertex_some_edge.clear();
+    edge_from_vert.clear();
+    edge_next.clear();
+    edge_converse.clear();
+    edge_face.clear();
+    face_edge.clear();
+}
@@ -0,0 +1,67 @@
+#ifndef HALFEDGEMESHSOA_H
+#define HALFEDGEMESHSOA_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "../Kernel.h"
+
+class HE_Mesh;
+
+/**
+ "f" is short for face
+ "e" is short for edge
+ "v" is short for vertex
+*/
+
+/*!
+Read-only structure-of-arrays snapshot of a finished HE_Mesh.
+
+The HE_Mesh itself stores an array of structs (HE_Edge, HE_Vertex, HE_Face), which the handles hand out references into and which the boolean operations modify in place.
+Traversals which only read one or two fields per element (such as the support classification) are faster on one contiguous array per field,
+so this snapshot stores every field separately and the vertex locations as separate x, y and z arrays.
+
+The accessors mirror those of HE_EdgeHandle, HE_FaceHandle and HE_VertexHandle, but take and return indices.
+The snapshot is not updated when the mesh changes; construct a new one after modifying the mesh.
+*/
+class HE_MeshSoA
+{
+public:
+    std::vector<int32_t> vertex_x; //!< x coordinate of each vertex
+    std::vector<int32_t> vertex_y; //!< y coordinate of each vertex
+    std::vector<int32_t> vertex_z; //!< z coordinate of each vertex
+    std::vector<int> vertex_some_edge; //!< HE_Vertex::someEdge_idx
+
+    std::vector<int> edge_from_vert; //!< HE_Edge::from_vert_idx
+    std::vector<int> edge_next; //!< HE_Edge::next_edge_idx
+    std::vector<int> edge_converse; //!< HE_Edge::converse_edge_idx
+    std::vector<int> edge_face; //!< HE_Edge::face_idx
+
+    std::vector<int> face_edge; //!< HE_Face::edge_idx, three consecutive edges per face
+
+    HE_MeshSoA() {};
+    HE_MeshSoA(const HE_Mesh& mesh); //!< snapshot of \p mesh
+
+    void clear(); //!< clears all data
+
+    int vertexCount() const { return vertex_x.size(); };
+    int edgeCount() const { return edge_from_vert.size(); };
+    int faceCount() const { return face_edge.size() / 3; };
+
+    Point p(int v) const { return Point(vertex_x[v], vertex_y[v], vertex_z[v]); };
+    int someEdge(int v) const { return vertex_some_edge[v]; };
+
+    int from_vert(int e) const { return edge_from_vert[e]; };
+    int to_vert(int e) const { return edge_from_vert[edge_next[e]]; };
+    int next(int e) const { return edge_next[e]; };
+    int converse(int e) const { return edge_converse[e]; };
+    int face(int e) const { return edge_face[e]; };
+    Point p0(int e) const { return p(from_vert(e)); };
+    Point p1(int e) const { return p(to_vert(e)); };
+
+    int edge(int f, int i) const { return face_edge[3 * f + i]; };
+    int v(int f, int i) const { return edge_from_vert[edge(f, i)]; };
+    Point p(int f, int i) const { return p(v(f, i)); };
+};
+
+#endif // HALFEDGEMESHSOA_H
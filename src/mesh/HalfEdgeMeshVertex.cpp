@@ -24,23 +24,12 @@
 #endif
 
 
-HE_EdgeHandle HE_VertexHandle::someEdge()
-{
-    return HE_EdgeHandle(*m, m->vertices[idx].someEdge_idx);
-}
-
-Point& HE_VertexHandle::p() { return vertex().p; };
-Point HE_VertexHandle::p_const() const { return m->vertices[idx].p; };
-
-HE_Vertex& HE_VertexHandle::vertex()
-{
-    return m->vertices[idx];
-};
+// the accessors someEdge, p, p_const and vertex are defined inline in HalfEdgeMesh.h
 
 
 bool HE_VertexHandle::isManifold(FVMeshVertexHandle& correspondingFVMeshVertex)
 {
-    if (correspondingFVMeshVertex.vertex().connected_faces.size() < 6) return true;
+    if (correspondingFVMeshVertex.connectedFaces().size() < 6) return true;
     // for a correct model, the minimal amount of faces sharing a vertex in a 2D manifold is 3
     // and we need at least 6 faces to connect 2 such manifolds, leading to a non-manifold vertex
 
@@ -51,7 +40,7 @@ bool HE_VertexHandle::isManifold(FVMeshVertexHandle& correspondingFVMeshVertex)
 
 void HE_VertexHandle::getConnectedEdgeGroups(FVMeshVertexHandle& correspondingFVMeshVertex, std::vector<std::vector<HE_EdgeHandle>> & result)
 {
-    std::vector<uint32_t>& connected_faces_idx = correspondingFVMeshVertex.vertex().connected_faces;
+    FVMeshConnectedFaces connected_faces_idx = correspondingFVMeshVertex.connectedFaces();
     std::set<uint32_t> checkedFaces;
 
     for (int f = 0; f < connected_faces_idx.size(); f++)
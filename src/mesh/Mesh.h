@@ -6,6 +6,7 @@
 
 #include "../settings.h"
 #include <iostream> // ostream
+#include <vector>
 
 #include "../Kernel.h"
 
@@ -35,24 +36,26 @@ It contains (a list of) all vertices and faces.
 A vertex has a location, p.
 A face can access its three vertices (indirectly).
 
+The vertices and faces are stored in a std::vector by default.
+A mesh which refers to its elements by pointer can store them in a container with stable addresses instead, such as a BlockPool.
 
 */
 
-template<typename Vertex, typename VertexHandle, typename Face, typename FaceHandle>
+template<typename Vertex, typename VertexHandle, typename Face, typename FaceHandle, typename VertexContainer = std::vector<Vertex>, typename FaceContainer = std::vector<Face>>
 class Mesh : public SettingsBase // inherits settings
 {
     typedef Vertex V;
     typedef VertexHandle VH;
     typedef Face F;
     typedef FaceHandle FH;
-    typedef Mesh<V,VH,F,FH> M;
+    typedef Mesh<V,VH,F,FH,VertexContainer,FaceContainer> M;
     static_assert(std::is_base_of<MeshVertex, Vertex>::value, "Cannot instantiate a Mesh with those types!");
 //    static_assert(std::is_base_of<MeshVertexHandle<V,F,FH,M>, VertexHandle>::value, "msg");
     static_assert(std::is_base_of<MeshFace<Vertex>, Face>::value, "Cannot instantiate a Mesh with those types!");
 //    static_assert(std::is_base_of<MeshFaceHandle<V,VH,F,M>, FaceHandle>::value, "msg");
 public:
-    std::vector<Vertex> vertices;//!< list of all vertices in the mesh
-    std::vector<Face> faces; //!< list of all faces in the mesh
+    VertexContainer vertices;//!< list of all vertices in the mesh
+    FaceContainer faces; //!< list of all faces in the mesh
 
     Mesh(SettingsBase* parent) //!< initializes the settings
     : SettingsBase(parent)
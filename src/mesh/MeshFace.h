@@ -24,10 +24,15 @@ class MeshFace
 
 };
 
-template<typename V, typename VH, typename F, typename M>
+/*!
+Base of the face handles of the different mesh types.
+
+The derived face handle FH is passed as template parameter (CRTP) and should implement v0(), v1() and v2(),
+so that all functions below resolve statically and can be inlined; a face handle has no vtable.
+*/
+template<typename FH, typename V, typename VH, typename F, typename M>
 struct MeshFaceHandle
 {
-    typedef MeshFaceHandle<V,VH,F,M> FH;
 //    BOOST_STATIC_ASSERT((boost::is_base_of<MeshFace<V>, F>::value));
 //    BOOST_STATIC_ASSERT((boost::is_base_of<Mesh<V,VH,F,FH>, M>::value));
     M* m;
@@ -36,29 +41,80 @@ struct MeshFaceHandle
 
     F& face() { return m->faces[idx]; };
 
-    virtual VH v0() const =0;
-    virtual VH v1() const =0;
-    virtual VH v2() const =0;
+    const FH& derived() const { return static_cast<const FH&>(*this); };
 
     VH v(int i) const {
         switch(i)
         {
-        case 0: return v0();
-        case 1: return v1();
-        case 2: return v2();
+        case 0: return derived().v0();
+        case 1: return derived().v1();
+        case 2: return derived().v2();
         }
-        return v0();
+        return derived().v0();
     }
 
-    Point& p0() const { return v0().vertex().p; };
-    Point& p1() const { return v1().vertex().p; };
-    Point& p2() const { return v2().vertex().p; };
+    Point& p0() const { return derived().v0().vertex().p; };
+    Point& p1() const { return derived().v1().vertex().p; };
+    Point& p2() const { return derived().v2().vertex().p; };
 
     Point norm() const { return ( p1() - p0() ).cross( p2() - p0() ); };
     FPoint normal() const { return FPoint( norm() ).normalized(); };
 
     BoundingBox bbox() const { return BoundingBox(p0(), p1()) + p2(); };
 
+    /*!
+    The squared distance from \p p to the nearest point on the triangle.
+
+    Determines the Voronoi region of the triangle (vertex, edge or interior) in which \p p projects,
+    as in Ericson, Real-Time Collision Detection, 5.1.5.
+    */
+    double squaredDistance(const Point& p) const
+    {
+        const Point& a = p0();
+        const Point& b = p1();
+        const Point& c = p2();
+        double ab[3] = { double(b.x) - a.x, double(b.y) - a.y, double(b.z) - a.z };
+        double ac[3] = { double(c.x) - a.x, double(c.y) - a.y, double(c.z) - a.z };
+        double ap[3] = { double(p.x) - a.x, double(p.y) - a.y, double(p.z) - a.z };
+        auto dot = [](const double* u, const double* v) { return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]; };
+        auto squaredDistanceTo = [&ap](double s, const double* u, double t, const double* v)
+        { // squared distance from p to a + s * u + t * v
+            double d[3] = { ap[0] - s * u[0] - t * v[0], ap[1] - s * u[1] - t * v[1], ap[2] - s * u[2] - t * v[2] };
+            return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        };
+
+        double d1 = dot(ab, ap);
+        double d2 = dot(ac, ap);
+        if (d1 <= 0 && d2 <= 0) return squaredDistanceTo(0, ab, 0, ac); // vertex a
+
+        double bp[3] = { double(p.x) - b.x, double(p.y) - b.y, double(p.z) - b.z };
+        double d3 = dot(ab, bp);
+        double d4 = dot(ac, bp);
+        if (d3 >= 0 && d4 <= d3) return squaredDistanceTo(1, ab, 0, ac); // vertex b
+
+        double vc = d1 * d4 - d3 * d2;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0) return squaredDistanceTo(d1 / (d1 - d3), ab, 0, ac); // edge ab
+
+        double cp[3] = { double(p.x) - c.x, double(p.y) - c.y, double(p.z) - c.z };
+        double d5 = dot(ab, cp);
+        double d6 = dot(ac, cp);
+        if (d6 >= 0 && d5 <= d6) return squaredDistanceTo(0, ab, 1, ac); // vertex c
+
+        double vb = d5 * d2 - d1 * d6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0) return squaredDistanceTo(0, ab, d2 / (d2 - d6), ac); // edge ac
+
+        double va = d3 * d6 - d5 * d4;
+        if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+        { // edge bc
+            double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            return squaredDistanceTo(1 - w, ab, w, ac);
+        }
+
+        double denom = va + vb + vc;
+        if (denom == 0) return squaredDistanceTo(0, ab, 0, ac); // degenerate triangle; all cases above failed only by rounding
+        return squaredDistanceTo(vb / denom, ab, vc / denom, ac); // interior
+    };
+
     CSVi toLines() const
     {
         CSVi csv;
@@ -69,7 +125,7 @@ struct MeshFaceHandle
         return csv;
     }
 
-    bool hasVertex(VH vh) const { return v0()==vh || v1()==vh || v2()==vh; };
+    bool hasVertex(VH vh) const { return derived().v0()==vh || derived().v1()==vh || derived().v2()==vh; };
 
     Point& p(int i)  const
     {
@@ -82,15 +138,15 @@ struct MeshFaceHandle
         return p0();
     }
 
-    virtual bool operator==(const MeshFaceHandle& b) const { return idx==b.idx && m==b.m; }; // TODO: more sophisticated check
-    virtual bool operator!=(const MeshFaceHandle &other) const {
+    bool operator==(const MeshFaceHandle& b) const { return idx==b.idx && m==b.m; }; // TODO: more sophisticated check
+    bool operator!=(const MeshFaceHandle &other) const {
         return !(*this == other);
     };
 
     template<class CharT, class TraitsT>
     friend
     std::basic_ostream<CharT, TraitsT>&
-    operator <<(std::basic_ostream<CharT, TraitsT>& os, const MeshFaceHandle<V,VH,F,M>& b)
+    operator <<(std::basic_ostream<CharT, TraitsT>& os, const MeshFaceHandle<FH,V,VH,F,M>& b)
     {
         os << b.m <<" . " << b.idx;
 
@@ -18,10 +18,10 @@ class MeshVertex
 {
 public:
     Point p; //!< location of the vertex
-    MeshVertex(Point p) : p(p) {} //!< doesn't set connected_faces
+    MeshVertex(Point p) : p(p) {}
 };
 
-template<typename Vertex, typename VertexHandle, typename Face, typename FaceHandle>
+template<typename Vertex, typename VertexHandle, typename Face, typename FaceHandle, typename VertexContainer, typename FaceContainer>
 class Mesh;
 
 template<typename V, typename F, typename FH, typename M>
@@ -37,8 +37,8 @@ struct MeshVertexHandle
     V& vertex() { return m->vertices[idx]; };
     Point& p() { return m->vertices[idx].p; };
 
-    virtual bool operator==(const MeshVertexHandle& b) const { return idx==b.idx && m==b.m; }; // TODO: more sophisticated check
-    virtual bool operator!=(const MeshVertexHandle &other) const {
+    bool operator==(const MeshVertexHandle& b) const { return idx==b.idx && m==b.m; }; // TODO: more sophisticated check
+    bool operator!=(const MeshVertexHandle &other) const {
         return !(*this == other);
     }
 };
@@ -0,0 +1,89 @@
+#include "VertexHashTable.h"
+
+#include "../utils/parallel.h"
+
+VertexHashTable::VertexHashTable(spaceType meld_distance)
+: n_entries(0)
+, mask(0)
+, meld_distance(meld_distance)
+, cell_size(meld_distance * 2)
+{
+}
+
+void VertexHashTable::clear()
+{
+    std::vector<Slot>().swap(slots);
+    n_entries = 0;
+    mask = 0;
+}
+
+void VertexHashTable::reserve(size_t n_vertices)
+{
+    size_t n_slots = 16;
+    while (n_slots < n_vertices * 2) // keep the load factor at most one half
+        n_slots *= 2;
+    if (n_slots > slots.size())
+        rehash(n_slots);
+}
+
+void VertexHashTable::insert(const Point3& p, uint32_t vertex_idx)
+{
+    if ((n_entries + 1) * 2 > slots.size())
+        rehash((slots.size() < 16)? 16 : slots.size() * 2);
+    uint64_t key = cellKey(cell(p.x), cell(p.y), cell(p.z));
+    uint64_t s = slotIndex(key);
+    while (slots[s].vertex_idx != EMPTY)
+        s = (s + 1) & mask;
+    slots[s].key = key;
+    slots[s].vertex_idx = vertex_idx;
+    n_entries++;
+}
+
+void VertexHashTable::rehash(size_t n_slots)
+{
+    std::vector<Slot> old_slots(n_slots);
+    old_slots.swap(slots);
+    for (Slot& slot : slots)
+        slot.vertex_idx = EMPTY;
+    mask = n_slots - 1;
+    for (const Slot& slot : old_slots)
+    {
+        if (slot.vertex_idx == EMPTY)
+            continue;
+        uint64_t s = slotIndex(slot.key);
+        while (slots[s].vertex_idx != EMPTY)
+            s = (s + 1) & mask;
+        slots[s] = slot;
+    }
+}
+
+void VertexHashTable::findFirstOccurrences(const Point3* points, size_t n, std::vector<uint32_t>& first_occurrence)
+{
+    // sort the points on location; ties are broken on index, so the order is fully determined
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; i++)
+        order[i] = i;
+    parallelSort(order.begin(), order.end(), [points](uint32_t a, uint32_t b)
+        {
+            const Point3& pa = points[a];
+            const Point3& pb = points[b];
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            if (pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        });
+
+    first_occurrence.resize(n);
+    parallelForRanges(n, [&](unsigned int, size_t begin, size_t end)
+        {
+            size_t group_start = begin;
+            while (group_start > 0 && points[order[group_start - 1]] == points[order[begin]])
+                group_start--; // the group started in the previous range
+            for (size_t k = begin; k < end; k++)
+            {
+                if (points[order[k]] != points[order[group_start]])
+                    group_start = k;
+                first_occurrence[order[k]] = order[group_start];
+            }
+        });
+}
@@ -0,0 +1,118 @@
+#ifndef VERTEX_HASH_TABLE_H
+#define VERTEX_HASH_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "../Kernel.h"
+
+/*!
+Spatial hash used to weld vertices which lie within a meld distance of each other.
+
+Space is divided into cubic cells with sides of twice the meld distance.
+Any point within the meld distance of a point p then lies in one of the 2x2x2 cells nearest to p, so a lookup inspects only 8 cells.
+
+The table is a single flat array with open addressing (linear probing), keyed on the 64-bit packed cell coordinates.
+Every vertex gets its own entry, so a cell containing multiple vertices simply occupies multiple slots.
+Apart from growing the array no memory is allocated when inserting vertices.
+
+Cell coordinates are packed in 21 bits each, which wraps around every 2^21 cells (about 125 meters with the default meld distance).
+Wrapped cells only share keys; all candidates are checked on their actual distance, so this never produces wrong matches.
+*/
+class VertexHashTable
+{
+    struct Slot
+    {
+        uint64_t key; //!< the packed cell coordinates
+        uint32_t vertex_idx; //!< the index of the vertex in this slot, or EMPTY
+    };
+    static const uint32_t EMPTY = 0xffffffff;
+
+    std::vector<Slot> slots; //!< the table itself; the size is always a power of two
+    size_t n_entries; //!< number of occupied slots
+    uint64_t mask; //!< slots.size() - 1
+    spaceType meld_distance; //!< maximal distance between two points which are considered the same vertex
+    spaceType cell_size; //!< twice the meld_distance
+public:
+    VertexHashTable(spaceType meld_distance);
+
+    void clear(); //!< remove all entries and release the memory
+    void reserve(size_t n_vertices); //!< make sure \p n_vertices can be inserted without rehashing
+
+    size_t size() const { return n_entries; }
+    spaceType getMeldDistance() const { return meld_distance; }
+
+    void insert(const Point3& p, uint32_t vertex_idx); //!< register that the vertex with index \p vertex_idx is located at \p p
+
+    /*!
+    Find the vertex with the lowest index among the vertices within the meld distance of \p p.
+    The lowest index is returned (rather than the first one found) so that the result doesn't depend on the layout of the table.
+
+    \param get_point returns the location of a vertex given its index
+    \return the index of the vertex, or -1 if no vertex is close enough
+    */
+    template<typename GetPoint>
+    int find(const Point3& p, const GetPoint& get_point) const
+    {
+        uint32_t best = EMPTY;
+        forEachCandidate(p, [&](uint32_t vertex_idx)
+            {
+                if (vertex_idx < best && (get_point(vertex_idx) - p).testLength(meld_distance))
+                    best = vertex_idx;
+            });
+        return (best == EMPTY)? -1 : int(best);
+    }
+
+    /*!
+    Call \p handle with the index of each vertex in the 2x2x2 cells nearest to \p p.
+    This includes all vertices within the meld distance of \p p, but also some which are further away; the caller has to check the distance.
+    */
+    template<typename Handle>
+    void forEachCandidate(const Point3& p, const Handle& handle) const
+    {
+        if (n_entries == 0)
+            return;
+        int64_t cx = cell(p.x), cy = cell(p.y), cz = cell(p.z);
+        // the neighbouring cell in each direction: below if p lies in the lower half of its cell, above otherwise
+        int64_t nx = (p.x - cx * cell_size < meld_distance)? cx - 1 : cx + 1;
+        int64_t ny = (p.y - cy * cell_size < meld_distance)? cy - 1 : cy + 1;
+        int64_t nz = (p.z - cz * cell_size < meld_distance)? cz - 1 : cz + 1;
+        for (int i = 0; i < 8; i++)
+        {
+            uint64_t key = cellKey((i & 1)? nx : cx, (i & 2)? ny : cy, (i & 4)? nz : cz);
+            for (uint64_t s = slotIndex(key); slots[s].vertex_idx != EMPTY; s = (s + 1) & mask)
+            {
+                if (slots[s].key == key)
+                    handle(slots[s].vertex_idx);
+            }
+        }
+    }
+
+    /*!
+    For each of the \p n \p points compute the lowest index of a point at exactly the same location, using a parallel sort.
+
+    When welding a list of points in order, only the first occurrence of each location needs to be looked up:
+    find() returns the lowest index in range, and all vertices created after the first occurrence have a higher index,
+    so any later point at the same location would be welded to the same vertex anyway.
+    */
+    static void findFirstOccurrences(const Point3* points, size_t n, std::vector<uint32_t>& first_occurrence);
+
+private:
+    //! the cell coordinate along one axis; rounds toward negative infinity
+    int64_t cell(spaceType coord) const
+    {
+        return (coord >= 0)? coord / cell_size : -((-int64_t(coord) + cell_size - 1) / cell_size);
+    }
+    static uint64_t cellKey(int64_t cx, int64_t cy, int64_t cz)
+    {
+        const uint64_t bits = (uint64_t(1) << 21) - 1;
+        return ((uint64_t(cx) & bits) << 42) | ((uint64_t(cy) & bits) << 21) | (uint64_t(cz) & bits);
+    }
+    uint64_t slotIndex(uint64_t key) const
+    {
+        return ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask; // Fibonacci hashing spreads neighbouring cells over the table
+    }
+    void rehash(size_t n_slots); //!< move all entries to a table with \p n_slots slots
+};
+
+#endif//VERTEX_HASH_TABLE_H
@@ -2,129 +2,159 @@
 #include <string.h>
 #include <strings.h>
 #include <stdio.h>
+#include <ctype.h>
 
 #include "modelFile.h"
+#include "../mesh/HalfEdgeMesh.h"
 #include "../utils/logoutput.h"
 #include "../utils/string.h"
+#include "../utils/mappedFile.h"
+#include "../utils/parallel.h"
 
 #include <fstream> // write to file
 
 FILE* binaryFVMeshBlob = nullptr;
 
-/* Custom fgets function to support Mac line-ends in Ascii STL files. OpenSCAD produces this when used on Mac */
-void* fgets_(char* ptr, size_t len, FILE* f)
+/*!
+Find the start of the facet following position \p pos in [\p begin, \p end), i.e. the position just after the next "endfacet" line.
+Returns \p end if there is no further facet.
+*/
+static const char* findNextFacetBoundary(const char* begin, const char* end, const char* pos)
 {
-    while(len && fread(ptr, 1, 1, f) > 0)
+    static const char keyword[] = "endfacet";
+    const size_t keyword_length = sizeof(keyword) - 1;
+    for (const char* p = std::max(begin, pos); p + keyword_length <= end; p++)
     {
-        if (*ptr == '\n' || *ptr == '\r')
+        p = static_cast<const char*>(memchr(p, 'e', end - p));
+        if (p == nullptr || p + keyword_length > end)
+            break;
+        if (memcmp(p, keyword, keyword_length) == 0)
         {
-            *ptr = '\0';
-            return ptr;
+            p += keyword_length;
+            while (p < end && *p != '\n' && *p != '\r') p++; // skip the rest of the line
+            return p;
         }
-        ptr++;
-        len--;
     }
-    return nullptr;
+    return end;
 }
 
-bool loadModelSTL_ascii(FVMesh* mesh, const char* filename, FMatrix3x3& matrix)
+/*!
+Parse all "vertex x y z" lines in [\p begin, \p end) and append the vertices, transformed by \p matrix, to \p result.
+Lines may end in LF, CR LF or just CR (OpenSCAD produces the latter on Mac).
+*/
+static void parseSTLVertices(const char* begin, const char* end, FMatrix3x3& matrix, std::vector<Point3>& result)
 {
-    FILE* f = fopen(filename, "rt");
-    char buffer[1024];
-    FPoint3 vertex;
-    int n = 0;
-    Point3 v0(0,0,0), v1(0,0,0), v2(0,0,0);
-    while(fgets_(buffer, sizeof(buffer), f))
+    const char* p = begin;
+    while (p < end)
     {
-        if (sscanf(buffer, " vertex %f %f %f", &vertex.x, &vertex.y, &vertex.z) == 3)
+        while (p < end && isspace(static_cast<unsigned char>(*p))) p++; // skip to the first word of the next line
+        const char* line_end = p;
+        while (line_end < end && *line_end != '\n' && *line_end != '\r') line_end++;
+
+        if (line_end - p > 6 && memcmp(p, "vertex", 6) == 0)
+        {
+            const char* pos = p + 6;
+            FPoint3 vertex;
+            if (parseFloat(pos, line_end, vertex.x) && parseFloat(pos, line_end, vertex.y) && parseFloat(pos, line_end, vertex.z))
+                result.push_back(matrix.apply(vertex));
+        }
+        p = line_end;
+    }
+}
+
+template<class MeshT>
+static bool loadModelSTL_ascii(MeshT* mesh, const MappedFile& file, FMatrix3x3& matrix)
+{
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // split the file into one chunk per thread, on facet boundaries
+    unsigned int n_chunks = (file.size() > (1 << 20))? getThreadCount() : 1;
+    std::vector<const char*> chunk_bounds;
+    chunk_bounds.push_back(begin);
+    for (unsigned int c = 1; c < n_chunks; c++)
+        chunk_bounds.push_back(findNextFacetBoundary(chunk_bounds.back(), end, begin + file.size() * c / n_chunks));
+    chunk_bounds.push_back(end);
+
+    std::vector<std::vector<Point3>> chunk_vertices(n_chunks);
+    parallelForRanges(n_chunks, n_chunks, [&](unsigned int, size_t chunk_begin, size_t chunk_end)
         {
-            n++;
-            switch(n)
+            for (size_t c = chunk_begin; c < chunk_end; c++)
             {
-            case 1:
-                v0 = matrix.apply(vertex);
-                break;
-            case 2:
-                v1 = matrix.apply(vertex);
-                break;
-            case 3:
-                v2 = matrix.apply(vertex);
-                mesh->addFace(v0, v1, v2);
-                n = 0;
-                break;
+                parseSTLVertices(chunk_bounds[c], chunk_bounds[c + 1], matrix, chunk_vertices[c]);
             }
-        }
+        }, 1);
+
+    // merge the chunks in file order; every 3 consecutive vertices make a face
+    size_t n_vertices = 0;
+    for (std::vector<Point3>& vertices : chunk_vertices)
+        n_vertices += vertices.size();
+    std::vector<Point3> vertices;
+    vertices.reserve(n_vertices);
+    for (std::vector<Point3>& chunk : chunk_vertices)
+    {
+        vertices.insert(vertices.end(), chunk.begin(), chunk.end());
+        std::vector<Point3>().swap(chunk); // free memory as we go
     }
-    fclose(f);
+    mesh->addFaces(vertices.data(), n_vertices / 3);
     mesh->finish();
     return true;
 }
 
-bool loadModelSTL_binary(FVMesh* mesh, const char* filename, FMatrix3x3& matrix)
+template<class MeshT>
+static bool loadModelSTL_binary(MeshT* mesh, const MappedFile& file, FMatrix3x3& matrix)
 {
-    FILE* f = fopen(filename, "rb");
-    char buffer[80];
-    uint32_t faceCount;
-    //Skip the header
-    if (fread(buffer, 80, 1, f) != 1)
+    //The file is an 80 byte header, the face count and then 50 bytes per face:
+    //float(x,y,z) = normal, float(X,Y,Z)*3 = vertexes, uint16_t = flags
+    const size_t header_size = 80 + sizeof(uint32_t);
+    const size_t record_size = 50;
+    if (file.size() < header_size)
     {
-        fclose(f);
+        atlas::logError("Binary STL file is too small to contain a header.\n");
         return false;
     }
-    //Read the face count
-    if (fread(&faceCount, sizeof(uint32_t), 1, f) != 1)
+    uint32_t faceCount;
+    memcpy(&faceCount, file.data() + 80, sizeof(uint32_t));
+
+    uint64_t expected_size = header_size + uint64_t(faceCount) * record_size;
+    if (file.size() < expected_size)
     {
-        fclose(f);
+        atlas::logError("Binary STL file is truncated: header announces %u faces, but the file only holds %u.\n", faceCount, unsigned((file.size() - header_size) / record_size));
         return false;
     }
-    //For each face read:
-    //float(x,y,z) = normal, float(X,Y,Z)*3 = vertexes, uint16_t = flags
-    for(unsigned int i=0;i<faceCount;i++)
-    {
-        if (fread(buffer, sizeof(float) * 3, 1, f) != 1)
-        {
-            fclose(f);
-            return false;
-        }
-        float v[9];
-        if (fread(v, sizeof(float) * 9, 1, f) != 1)
-        {
-            fclose(f);
-            return false;
-        }
-        Point3 v0 = matrix.apply(FPoint3(v[0], v[1], v[2]));
-        Point3 v1 = matrix.apply(FPoint3(v[3], v[4], v[5]));
-        Point3 v2 = matrix.apply(FPoint3(v[6], v[7], v[8]));
-        mesh->addFace(v0, v1, v2);
-        if (fread(buffer, sizeof(uint16_t), 1, f) != 1)
+    if (file.size() > expected_size)
+        atlas::log("Warning! Binary STL file has %u bytes of trailing data after the last face.\n", unsigned(file.size() - expected_size));
+
+    const char* records = file.data() + header_size;
+    std::vector<Point3> vertices(size_t(faceCount) * 3);
+    parallelFor(faceCount, [&](size_t i)
         {
-            fclose(f);
-            return false;
-        }
-    }
-    fclose(f);
+            float v[9];
+            memcpy(v, records + i * record_size + sizeof(float) * 3, sizeof(v)); // skip the normal; records aren't 4-byte aligned, so don't cast in place
+            vertices[i * 3] = matrix.apply(FPoint3(v[0], v[1], v[2]));
+            vertices[i * 3 + 1] = matrix.apply(FPoint3(v[3], v[4], v[5]));
+            vertices[i * 3 + 2] = matrix.apply(FPoint3(v[6], v[7], v[8]));
+        });
+    mesh->addFaces(vertices.data(), faceCount);
     mesh->finish();
     return true;
 }
 
-bool loadModelSTL(FVMesh* mesh, const char* filename, FMatrix3x3& matrix)
+template<class MeshT>
+static bool loadModelSTL_any(MeshT* mesh, const char* filename, FMatrix3x3& matrix)
 {
-    FILE* f = fopen(filename, "r");
-    char buffer[6];
-    if (f == nullptr)
+    MappedFile file;
+    if (!file.open(filename))
         return false;
-
-    if (fread(buffer, 5, 1, f) != 1)
-    {
-        fclose(f);
+    if (file.size() < 5)
         return false;
-    }
-    fclose(f);
 
+    char buffer[6];
+    memcpy(buffer, file.data(), 5);
     buffer[5] = '\0';
     if (stringcasecompare(buffer, "solid") == 0)
     {
-        bool load_success = loadModelSTL_ascii(mesh, filename, matrix);
+        bool load_success = loadModelSTL_ascii(mesh, file, matrix);
         if (!load_success)
             return false;
 
@@ -133,11 +163,21 @@ bool loadModelSTL(FVMesh* mesh, const char* filename, FMatrix3x3& matrix)
         if (mesh->faces.size() < 1)
         {
             mesh->clear();
-            return loadModelSTL_binary(mesh, filename, matrix);
+            return loadModelSTL_binary(mesh, file, matrix);
         }
         return true;
     }
-    return loadModelSTL_binary(mesh, filename, matrix);
+    return loadModelSTL_binary(mesh, file, matrix);
+}
+
+bool loadModelSTL(FVMesh* mesh, const char* filename, FMatrix3x3& matrix)
+{
+    return loadModelSTL_any(mesh, filename, matrix);
+}
+
+bool loadModelSTL(HE_Mesh* mesh, const char* filename, FMatrix3x3& matrix)
+{
+    return loadModelSTL_any(mesh, filename, matrix);
 }
 
 bool loadFVMeshFromFile(PrintObject* object, const char* filename, FMatrix3x3& matrix)
@@ -80,7 +80,10 @@ public:
     }
 };
 
+class HE_Mesh;
+
 bool loadModelSTL(FVMesh* mesh, const char* filename, FMatrix3x3& matrix);
+bool loadModelSTL(HE_Mesh* mesh, const char* filename, FMatrix3x3& matrix); //!< load an STL file directly into a half-edge mesh, without an FVMesh in between
 
 bool loadFVMeshFromFile(PrintObject* object, const char* filename, FMatrix3x3& matrix);
 
@@ -12,6 +12,12 @@
 #include <algorithm> // std::binary_search
 
 #include "mesh/HalfEdgeMesh.h"
+#include "mesh/HalfEdgeMeshSoA.h"
+
+#include "utils/parallel.h"
+#include "utils/predicates.h" // orient2d
+
+#include "AABB_Tree.h" // thinOut
 
 
 #include "MACROS.h" // debug
@@ -30,43 +36,62 @@ namespace atlas {
 
 SupportChecker SupportChecker::getSupportRequireds(FVMesh& mesh, double maxAngle)
 {
-
     SupportChecker supporter(mesh, maxAngle);
+    supporter.computeSupportRequireds();
+    return supporter;
+}
+
+SupportChecker SupportChecker::getSupportRequireds(HE_Mesh mesh, double maxAngle)
+{
+    SupportChecker supporter(std::move(mesh), maxAngle);
+    supporter.computeSupportRequireds();
+    return supporter;
+}
+
+void SupportChecker::computeSupportRequireds()
+{
     ADV_SUP_DEBUG_DO(
         std::cerr << "-----------------------\n--getSupportRequireds--\n-----------------------" << std::endl;
-        std::cerr << "cosMaxAngle = " << supporter.cosMaxAngle << std::endl;
-        std::cerr << "cosMaxAngleNormal = " << supporter.cosMaxAngleNormal << std::endl;
+        std::cerr << "cosMaxAngle = " << cosMaxAngle << std::endl;
+        std::cerr << "cosMaxAngleNormal = " << cosMaxAngleNormal << std::endl;
     )
 
-    for (int f = 0 ; f < supporter.mesh.faces.size() ; f++)
+    // the classification only reads the mesh, and touches few fields per element: work on a structure-of-arrays copy
+    HE_MeshSoA soa(mesh);
+
+    const HE_FaceAttributes& faceAttributes = mesh.getFaceAttributes();
+    parallelFor(soa.faceCount(), [&](size_t f) { faceNormals[f] = faceAttributes.normal(f).toPoint3(); });
+    for (int f = 0 ; f < soa.faceCount() ; f++)
     {
-        supporter.faceIsBad[f] = supporter.faceNeedsSupport(supporter.mesh, f);
+        faceIsBad[f] = faceNeedsSupport(soa, f);
     }
 
-    for (int e = 0 ; e < supporter.mesh.edges.size() ; e++)
+    for (int e = 0 ; e < soa.edgeCount() ; e++)
     {
-        bool bad = supporter.edgeNeedsSupport(supporter.mesh, e);
-        supporter.edgeIsBad[e] = bad;
+        bool bad = edgeNeedsSupport(soa, e);
+        edgeIsBad[e] = bad;
         if (bad)
         {
-            supporter.edgeIsBad[supporter.mesh.edges[e].converse_edge_idx] = bad;
+            edgeIsBad[soa.converse(e)] = bad;
         }
     }
 
-    for (int v = 0 ; v < supporter.mesh.vertices.size() ; v++)
+    std::vector<char> vertex_is_bad(soa.vertexCount()); // std::vector<bool> cannot be written from multiple threads
+    parallelFor(soa.vertexCount(), [&](size_t v)
+        {
+            vertex_is_bad[v] = vertexNeedsSupport(soa, v);
+        });
+    for (int v = 0 ; v < soa.vertexCount() ; v++)
     {
-        supporter.vertexIsBad[v] = supporter.vertexNeedsSupport(supporter.mesh, v);
+        vertexIsBad[v] = vertex_is_bad[v];
     }
 
     ADV_SUP_DEBUG_DO( std::cerr << "------------------------\n--END SupportRequireds--\n------------------------" << std::endl; )
-    return supporter;
 }
 
-bool SupportChecker::faceNeedsSupport(HE_Mesh& mesh, int face_idx)
+bool SupportChecker::faceNeedsSupport(const HE_MeshSoA& mesh, int face_idx)
 {
-    Point3 normal = mesh.getNormal(face_idx);
-
-    faceNormals[face_idx] = normal;
+    Point3& normal = faceNormals[face_idx];
 
     double cosAngle = double(normal.z) / double(normal.vSize()); // fabs
 
@@ -78,27 +103,26 @@ bool SupportChecker::faceNeedsSupport(HE_Mesh& mesh, int face_idx)
 bool debug_support_edges_only = false;
 
 // supposes all faces have already been checked
-bool SupportChecker::edgeNeedsSupport(HE_Mesh& mesh, int edge_idx)
+bool SupportChecker::edgeNeedsSupport(const HE_MeshSoA& mesh, int edge_idx)
 {
     ADV_SUP_DEBUG_DO( std::cerr << "edge " << edge_idx << " : "; )
 
-    HE_EdgeHandle edge(mesh, edge_idx);
-    HE_EdgeHandle backEdge(edge); edge.converse();
-
-//    HE_Edge& edge = mesh.edges[edge_idx];
-//    HE_Edge& backEdge = mesh.edges[edge.converse_edge_idx];
+    int back_edge_idx = mesh.converse(edge_idx);
 
-    if (edgeIsBad[backEdge.idx])
+    if (edgeIsBad[back_edge_idx])
     {
         ADV_SUP_DEBUG_DO( std::cerr << " converse is bad" << std::endl; )
         return true;
     }
 
-    bool bad1 = faceIsBad[edge.face().idx];
-    bool bad2 = faceIsBad[backEdge.face().idx];
+    int face_1_idx = mesh.face(edge_idx);
+    int face_2_idx = mesh.face(back_edge_idx);
 
-    Point3 face_1_normal = faceNormals[edge.face().idx];
-    Point3 face_2_normal = faceNormals[backEdge.face().idx];
+    bool bad1 = faceIsBad[face_1_idx];
+    bool bad2 = faceIsBad[face_2_idx];
+
+    Point3 face_1_normal = faceNormals[face_1_idx];
+    Point3 face_2_normal = faceNormals[face_2_idx];
 
 
     if (bad1 != bad2) // xor : one bad one not... the edge of a bad area is always bad
@@ -114,7 +138,7 @@ bool SupportChecker::edgeNeedsSupport(HE_Mesh& mesh, int edge_idx)
 
     if (!bad1 && !bad2) // == !(bad1 && bad2) , since (bad1 != bad2) is already checked above
     { // check if angle with Z-axis is great enough to require support
-        Point3 vect = edge.p1() - edge.p0();
+        Point3 vect = mesh.p1(edge_idx) - mesh.p0(edge_idx);
         double absCosAngle = fabs( (double)vect.z / (double)vect.vSize() );
 
 
@@ -140,15 +164,15 @@ bool SupportChecker::edgeNeedsSupport(HE_Mesh& mesh, int edge_idx)
         }
     }
 
-    return edgeIsBelowFaces(mesh, edge);
+    return edgeIsBelowFaces(mesh, edge_idx);
 
 
 }
 
-bool SupportChecker::edgeIsBelowFaces(HE_Mesh& mesh, HE_EdgeHandle& edge)
+bool SupportChecker::edgeIsBelowFaces(const HE_MeshSoA& mesh, int edge_idx)
 {
-    Point3 a = edge.p0();
-    Point3 dac =  edge.p1() - a;
+    Point3 a = mesh.p0(edge_idx);
+    Point3 dac =  mesh.p1(edge_idx) - a;
     if (dac.x ==0 && dac.y ==0)
     {
         ADV_SUP_DEBUG_DO(                 if (debug_support_edges_only) std::cerr << "edge is vertical" << std::endl; )
@@ -159,16 +183,16 @@ bool SupportChecker::edgeIsBelowFaces(HE_Mesh& mesh, HE_EdgeHandle& edge)
 
     if (!std::isfinite(denom)) // then |dac.x| == |dac.y|
     {
-        return edgeIsBelowFacesDiagonal(mesh, edge, a, dac);
+        return edgeIsBelowFacesDiagonal(mesh, edge_idx, a, dac);
     } else
     {
-        return edgeIsBelowFacesNonDiagonal(mesh, edge, a, dac, denom);
+        return edgeIsBelowFacesNonDiagonal(mesh, edge_idx, a, dac, denom);
     }
 }
 
 double distanceWhichIsBasicallyZero = .01; // cos of angle which still counts as vertical. 0 < a << 1
 
-bool SupportChecker::edgeIsBelowFacesDiagonal(HE_Mesh& mesh, HE_EdgeHandle& edge, Point3& a, Point3& dac)
+bool SupportChecker::edgeIsBelowFacesDiagonal(const HE_MeshSoA& mesh, int edge_idx, Point3& a, Point3& dac)
 {
     assert(dac.x == dac.y || dac.x == -dac.y);
 
@@ -178,12 +202,12 @@ bool SupportChecker::edgeIsBelowFacesDiagonal(HE_Mesh& mesh, HE_EdgeHandle& edge
     double denom = 1. / (2 * dac.x);
 
     // first face
-    Point3 b = edge.next().p1(); // mesh.getTo(*mesh.getNext(edge))->p;
+    Point3 b = mesh.p1(mesh.next(edge_idx));
     Point3 dab =  b - a;
     if (!edgeIsBelowSingleFaceDiagonal(dab, dac, denom, sign)) return false;
 
     // second face
-    Point3 b2 = edge.converse().next().p1(); //mesh.getTo(*mesh.getNext(*mesh.getConverse(edge)))->p;
+    Point3 b2 = mesh.p1(mesh.next(mesh.converse(edge_idx)));
     Point3 dab2 =  b2 - a;
     if (!edgeIsBelowSingleFaceDiagonal(dab2, dac, denom, sign)) return false;
 
@@ -221,10 +245,10 @@ bool SupportChecker::edgeIsBelowSingleFaceDiagonal(Point3& dab, Point3& dac, dou
 
 
 
-bool SupportChecker::edgeIsBelowFacesNonDiagonal(HE_Mesh& mesh, HE_EdgeHandle& edge, Point3& a, Point3& dac, double denom)
+bool SupportChecker::edgeIsBelowFacesNonDiagonal(const HE_MeshSoA& mesh, int edge_idx, Point3& a, Point3& dac, double denom)
 {
     // first face
-    Point3 b = edge.next().p1(); // mesh.getTo(*mesh.getNext(edge))->p;
+    Point3 b = mesh.p1(mesh.next(edge_idx));
     Point3 dab =  b - a;
     if (!edgeIsBelowSingleFaceNonDiagonal(dab, dac, denom))
     {
@@ -232,7 +256,7 @@ bool SupportChecker::edgeIsBelowFacesNonDiagonal(HE_Mesh& mesh, HE_EdgeHandle& e
     }
 
     // second face
-    Point3 b2 = edge.converse().next().p1(); // mesh.getTo(*mesh.getNext(*mesh.getConverse(edge)))->p;
+    Point3 b2 = mesh.p1(mesh.next(mesh.converse(edge_idx)));
     Point3 dab2 =  b2 - a;
     if (!edgeIsBelowSingleFaceNonDiagonal(dab2, dac, denom))
     {
@@ -268,37 +292,32 @@ bool SupportChecker::edgeIsBelowSingleFaceNonDiagonal(Point3& dab, Point3& dac,
 }
 
 
-bool SupportChecker::vertexNeedsSupport(HE_Mesh& mesh, int vertex_idx)
+bool SupportChecker::vertexNeedsSupport(const HE_MeshSoA& mesh, int vertex_idx)
 {
     ADV_SUP_DEBUG_DO( std::cerr << "vertex " << vertex_idx << " : "; )
-//    HE_Vertex& vertex = mesh.vertices[vertex_idx];
-//    HE_Edge& someEdge = *mesh.getSomeEdge(vertex);
-    HE_VertexHandle vertex = HE_VertexHandle(mesh, vertex_idx);
-    HE_EdgeHandle someEdge = vertex.someEdge();
+    int some_edge_idx = mesh.someEdge(vertex_idx);
 
-    if (faceNormals[someEdge.face().idx].z > 0)
+    int some_face_idx = mesh.face(some_edge_idx);
+    if (orient2d(mesh.p(some_face_idx, 0), mesh.p(some_face_idx, 1), mesh.p(some_face_idx, 2)) > 0) // exactly whether the face points up, also when its rounded normal is horizontal
     {
         return false; // vertex can at most be the bottom of a concave dimple
     }
 
-    bool first = true;
+    int32_t vertex_z = mesh.vertex_z[vertex_idx];
     int wtfCounter = 0;
 
-    HE_EdgeHandle* departing_edge = new HE_EdgeHandle(someEdge);
+    int departing_edge_idx = some_edge_idx;
     do
-    //for (HE_Edge* departing_edge = &someEdge ; first || departing_edge != &someEdge ; departing_edge = mesh.getNext(*mesh.getConverse(*departing_edge)) )
     {
-        if (departing_edge->p1().z < vertex.p().z) return false;
-        first = false;
+        if (mesh.vertex_z[mesh.to_vert(departing_edge_idx)] < vertex_z) return false;
         wtfCounter++;
         if (wtfCounter>200)
         {
             atlas::logError("Cannot find starting edge when moving along all edges connected to a vertex.\n");
             std::exit(EXIT_FAILURE);
         }
-        HE_EdgeHandle nxt = departing_edge->converse().next();
-        departing_edge->set(nxt);
-    } while (*departing_edge != someEdge);
+        departing_edge_idx = mesh.next(mesh.converse(departing_edge_idx));
+    } while (departing_edge_idx != some_edge_idx);
     ADV_SUP_DEBUG_DO( std::cerr << std::endl; )
 
     ADV_SUP_DEBUG_DO( std::cerr << " vertex is bad" << std::endl; )
@@ -469,6 +488,68 @@ SupportPointsGenerator::SupportPointsGenerator(SupportChecker& supportChecker, i
             addSupportPointsFace(f);
         }
     }
+
+    thinOut(gridSize / 2);
+}
+
+namespace
+{
+/*!
+A support point as object of an AABB_Tree; used for finding the support points close to a given point.
+*/
+struct SupportPointRef
+{
+    Point3 p;
+    unsigned int point_idx; //!< index into SupportPointsGenerator::supportPoints
+    SupportPointRef(Point3 p, unsigned int point_idx) : p(p), point_idx(point_idx) {};
+    BoundingBox bbox() { return BoundingBox(p, p); };
+    double squaredDistance(const Point3& q) const
+    {
+        double dx = double(p.x) - q.x, dy = double(p.y) - q.y, dz = double(p.z) - q.z;
+        return dx * dx + dy * dy + dz * dz;
+    };
+};
+} // anonymous namespace
+
+void SupportPointsGenerator::thinOut(int32_t min_distance)
+{
+    if (supportPoints.size() < 2 || min_distance <= 0) return;
+
+    std::vector<SupportPointRef> refs;
+    refs.reserve(supportPoints.size());
+    for (unsigned int p = 0; p < supportPoints.size(); p++)
+    {
+        refs.emplace_back(supportPoints[p].p, p);
+    }
+    AABB_Tree<SupportPointRef> tree(refs.begin(), refs.end());
+
+    std::vector<bool> removed(supportPoints.size(), false);
+    std::vector<AABB_Neighbor> close;
+    for (unsigned int p = 0; p < supportPoints.size(); p++)
+    {
+        if (removed[p]) continue;
+        close.clear();
+        tree.withinRadius(supportPoints[p].p, min_distance, close);
+        for (AABB_Neighbor& n : close)
+        {
+            unsigned int other = tree.objects[n.object_idx].point_idx;
+            if (other > p && n.squared_distance < double(min_distance) * min_distance)
+            {
+                removed[other] = true;
+            }
+        }
+    }
+
+    unsigned int kept = 0;
+    for (unsigned int p = 0; p < supportPoints.size(); p++)
+    {
+        if (!removed[p])
+        {
+            if (kept != p) supportPoints[kept] = std::move(supportPoints[p]);
+            kept++;
+        }
+    }
+    supportPoints.erase(supportPoints.begin() + kept, supportPoints.end());
 }
 
 
@@ -5,6 +5,7 @@
 #include "modelFile/modelFile.h"
 
 #include "mesh/HalfEdgeMesh.h"
+#include "mesh/HalfEdgeMeshSoA.h"
 #include <iostream>
 
 namespace atlas {
@@ -39,6 +40,11 @@ class SupportChecker
         * \param maxAngle The max angle (0 is vertical) at which a part can reliably be printed. (0 < maxAngle < .5 pi)
         */
         static SupportChecker getSupportRequireds(FVMesh& mesh, double maxAngle);
+        /*!
+        * Same as above, but for a mesh which is already a half-edge mesh.
+        * The checker keeps its own copy of the mesh; pass a temporary (or use std::move) to avoid copying it.
+        */
+        static SupportChecker getSupportRequireds(HE_Mesh mesh, double maxAngle);
 
         double maxAngle;
 
@@ -62,12 +68,12 @@ class SupportChecker
         // wrongly implemented!!! now _\ has a good edge
         bool edgeOnBoundaryNotBadWhenFullySupported = false; //!< don't classify an edge as bad in case one face is bad, but the other face is pointing upward
 
-        SupportChecker(FVMesh mmesh, double maxAngleI)
+        SupportChecker(FVMesh& mmesh, double maxAngleI)
         : SupportChecker(HE_Mesh(mmesh), maxAngleI) {};
 
-        SupportChecker(HE_Mesh mmesh, double maxAngleI)
+        SupportChecker(HE_Mesh&& mmesh, double maxAngleI)
         : maxAngle(maxAngleI)
-        , mesh(mmesh)
+        , mesh(std::move(mmesh))
         , faceIsBad(mesh.faces.size())
         , edgeIsBad(mesh.edges.size())
         , vertexIsBad(mesh.vertices.size())
@@ -82,9 +88,11 @@ class SupportChecker
             faceNormals.resize(mesh.faces.size());
         };
 
-        bool faceNeedsSupport(HE_Mesh& mesh, int face_idx);
-        bool edgeNeedsSupport(HE_Mesh& mesh, int edge_idx);
-        bool vertexNeedsSupport(HE_Mesh& mesh, int vertex_idx);
+        void computeSupportRequireds(); //!< classify all faces, edges and vertices of the mesh
+
+        bool faceNeedsSupport(const HE_MeshSoA& mesh, int face_idx); //!< supposes the face normal has already been computed
+        bool edgeNeedsSupport(const HE_MeshSoA& mesh, int edge_idx);
+        bool vertexNeedsSupport(const HE_MeshSoA& mesh, int vertex_idx);
 
 
 
@@ -116,12 +124,12 @@ class SupportChecker
         \image html edge_overhang.png
 
         * \param mesh the mesh
-        * \param edge the edge to check
+        * \param edge_idx the edge to check
         */
-        inline bool edgeIsBelowFaces(HE_Mesh& mesh, HE_EdgeHandle& edge);
-        inline bool edgeIsBelowFacesDiagonal(HE_Mesh& mesh, HE_EdgeHandle& edge, Point3& a, Point3& dac); //!< Helper function for the edge case in which a horizontal line through the plane is perfectly diagonal, in which case the denom parameter of edgeIsBelowFacesNonDiagonal is not finite.
+        inline bool edgeIsBelowFaces(const HE_MeshSoA& mesh, int edge_idx);
+        inline bool edgeIsBelowFacesDiagonal(const HE_MeshSoA& mesh, int edge_idx, Point3& a, Point3& dac); //!< Helper function for the edge case in which a horizontal line through the plane is perfectly diagonal, in which case the denom parameter of edgeIsBelowFacesNonDiagonal is not finite.
         inline bool edgeIsBelowSingleFaceDiagonal(Point3& dab, Point3& dac, double denom, short sign);
-        inline bool edgeIsBelowFacesNonDiagonal(HE_Mesh& mesh, HE_EdgeHandle& edge, Point3& a, Point3& dac, double denom);
+        inline bool edgeIsBelowFacesNonDiagonal(const HE_MeshSoA& mesh, int edge_idx, Point3& a, Point3& dac, double denom);
         inline bool edgeIsBelowSingleFaceNonDiagonal(Point3& dab, Point3& dac, double denom);
 };
 
@@ -144,6 +152,7 @@ public:
 *
 * Generates points at regular intervals over all places which need support.
 * The points coincide with the junction points in a square grid.
+* Points closer than half the grid size to an earlier point are removed; see thinOut.
 *
 */
 class SupportPointsGenerator
@@ -161,6 +170,13 @@ public:
 
     SupportPointsGenerator(SupportChecker& supportChecker, int32_t vertexOffset, int32_t edgeOffset, int32_t faceOffset, int32_t gridSize);
 
+    /*!
+    Removes the support points closer than \p min_distance to a point which comes before them in supportPoints.
+
+    Points generated for vertices come first, so they are kept over the points of the edges and faces around them.
+    */
+    void thinOut(int32_t min_distance);
+
     static void testSupportPointsGenerator(PrintObject* model);
 
 protected:
@@ -2,6 +2,8 @@
 
 #include "modelFile/modelFile.h"
 
+#include "AABB_Tree.h"
+
 #include <fstream> // ofstream
 
 SupportBlockGenerator::~SupportBlockGenerator()
@@ -41,7 +43,7 @@ void SupportBlockGenerator::test(PrintObject* model)
         HE_Mesh mesh(model->meshes[mi]);
         std::cerr << " >>>>>>>>>>>>> support checker " << std::endl;
 
-        SupportChecker supporter = SupportChecker::getSupportRequireds(model->meshes[mi], .785); // 45/180*M_PI
+        SupportChecker supporter = SupportChecker::getSupportRequireds(mesh, .785); // 45/180*M_PI
 
         mesh.debugOuputBasicStats(std::cerr);
 
@@ -112,8 +114,48 @@ void SupportBlockGenerator::test(PrintObject* model)
 
 
 
+void SupportBlockGenerator::computeSupportBottoms()
+{
+    std::vector<HE_FaceHandle> faces;
+    for (int f = 0 ; f < mesh.faces.size() ; f++)
+    {
+        faces.emplace_back(mesh, f);
+    }
+    AABB_Tree<HE_FaceHandle, DefaultBoxer<HE_FaceHandle>, AABB_SAHSplit> tree(faces.begin(), faces.end());
+
+    spaceType build_plate_z = bbox.min.z + dZ_to_object;
+
+    std::vector<Ray> rays;
+    for (int v = 0 ; v < mesh.vertices.size() ; v++)
+    {
+        rays.emplace_back(mesh.vertices[v].p + dz, Point3(0, 0, -1));
+    }
+    std::vector<AABB_RayHit> hits;
+    tree.closestHits(rays, bbox.max.z - build_plate_z, [](const HE_FaceHandle& face, const Ray& ray, double t_max, double& t)
+        {
+            return ray.intersects(face.p0(), face.p1(), face.p2(), t_max, t);
+        }, hits);
+
+    vertex_bottom_z.resize(mesh.vertices.size());
+    for (int v = 0 ; v < mesh.vertices.size() ; v++)
+    {
+        spaceType top_z = mesh.vertices[v].p.z + dZ_to_object;
+        if (hits[v].isHit())
+        { // keep the same distance to the model below as to the model above
+            spaceType model_z = top_z - spaceType(hits[v].t);
+            vertex_bottom_z[v] = std::min(top_z, model_z - dZ_to_object);
+        }
+        else
+        {
+            vertex_bottom_z[v] = build_plate_z;
+        }
+    }
+}
+
 void SupportBlockGenerator::generateSupportBlocks(FVMesh& result)
 {
+    computeSupportBottoms();
+
 
     for (int f = 0 ; f < mesh.faces.size() ; f++)
     {
@@ -150,8 +192,6 @@ void SupportBlockGenerator::generateSupportBlocks(FVMesh& result)
     //    result.addFace(mesh.vertices[mesh.edges[face.edge_idx[0]].to_vert_idx].p, mesh.vertices[mesh.edges[face.edge_idx[1]].to_vert_idx].p, mesh.vertices[mesh.edges[face.edge_idx[2]].to_vert_idx].p);
 
     result.finish();
-
-    rebaseSupportBlocksOnModel(result);
 }
 
 
@@ -161,7 +201,7 @@ void SupportBlockGenerator::generateSupportBlocks(FVMesh& result)
 void SupportBlockGenerator::supportFace(int f, FVMesh& result)
 {
 
-    auto projectDown = [this](Point& p) { return Point(p.x,p.y,bbox.min.z + dZ_to_object); }; // TODO: remove everything below bbox.min.z
+    auto projectDown = [this](Point& p, int v) { return Point(p.x,p.y,vertex_bottom_z[v]); };
 
     HE_Face& face = mesh.faces[f];
 
@@ -169,9 +209,10 @@ void SupportBlockGenerator::supportFace(int f, FVMesh& result)
     Point3 p1_top = mesh.getTo(mesh.edges[face.edge_idx[1]])->p + dz;
     Point3 p2_top = mesh.getTo(mesh.edges[face.edge_idx[2]])->p + dz;
 
-    Point3 p0_bottom = projectDown(p0_top);
-    Point3 p1_bottom = projectDown(p1_top);
-    Point3 p2_bottom = projectDown(p2_top);
+    auto toVert = [this, &face](int i) { return mesh.edges[mesh.edges[face.edge_idx[i]].next_edge_idx].from_vert_idx; };
+    Point3 p0_bottom = projectDown(p0_top, toVert(0));
+    Point3 p1_bottom = projectDown(p1_top, toVert(1));
+    Point3 p2_bottom = projectDown(p2_top, toVert(2));
 
     result.addFace(p2_top, p1_top, p0_top); // top is flipped
     result.addFace(p0_bottom, p1_bottom, p2_bottom);
@@ -179,7 +220,7 @@ void SupportBlockGenerator::supportFace(int f, FVMesh& result)
 
 void SupportBlockGenerator::supportEdge(int e, FVMesh& result)
 {
-    auto projectDown = [this](Point& p) { return Point(p.x,p.y,bbox.min.z + dZ_to_object); }; // TODO: remove everything below bbox.min.z
+    auto projectDown = [this](Point& p, int v) { return Point(p.x,p.y,vertex_bottom_z[v]); };
     // face f0 is good and (converse face bad or edge bad)
 
     HE_Edge& edge = mesh.edges[e];
@@ -187,8 +228,8 @@ void SupportBlockGenerator::supportEdge(int e, FVMesh& result)
 
     Point3 p0_top = mesh.getFrom(edge)->p + dz;
     Point3 p1_top = mesh.getTo(edge)->p + dz;
-    Point3 p0_bottom = projectDown(p0_top);
-    Point3 p1_bottom = projectDown(p1_top);
+    Point3 p0_bottom = projectDown(p0_top, edge.from_vert_idx);
+    Point3 p1_bottom = projectDown(p1_top, mesh.edges[edge.next_edge_idx].from_vert_idx);
 
 
     if (p1_top.z < p0_top.z) // draw diagonal along the shortest crosssection of the quadrilateral
@@ -205,7 +246,7 @@ void SupportBlockGenerator::supportEdge(int e, FVMesh& result)
 void SupportBlockGenerator::supportVert(int v, FVMesh& result)
 {
 
-    auto projectDown = [this](Point& p) { return Point(p.x,p.y,bbox.min.z + dZ_to_object); }; // TODO: remove everything below bbox.min.z
+    auto projectDown = [this](Point& p, int v) { return Point(p.x,p.y,vertex_bottom_z[v]); };
 
     { // check whether vertex is isolated from connected overhang
         int startEdge = mesh.vertices[v].someEdge_idx;
@@ -225,9 +266,9 @@ void SupportBlockGenerator::supportVert(int v, FVMesh& result)
     p2_top += mesh.vertices[v].p;
 
 
-    Point3 p0_bottom = projectDown(p0_top);
-    Point3 p1_bottom = projectDown(p1_top);
-    Point3 p2_bottom = projectDown(p2_top);
+    Point3 p0_bottom = projectDown(p0_top, v); // the pillar is thin, so it ends where the ray below its vertex hits the model
+    Point3 p1_bottom = projectDown(p1_top, v);
+    Point3 p2_bottom = projectDown(p2_top, v);
 
     //pillar creation:
     result.addFace(p0_top, p1_top, p2_top); // top
@@ -241,28 +282,3 @@ void SupportBlockGenerator::supportVert(int v, FVMesh& result)
     result.addFace(p2_top, p2_bottom, p1_bottom);
     result.addFace(p0_top, p0_bottom, p2_bottom);
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-void SupportBlockGenerator::rebaseSupportBlocksOnModel(FVMesh& result)
-{
-
-
-
-
-}
@@ -34,12 +34,11 @@ class SupportBlockGenerator
         SupportChecker checker;
         HE_Mesh mesh;
         BoundingBox bbox;
+        std::vector<spaceType> vertex_bottom_z; //!< for each vertex of the mesh the z to which the support below it extends
 
         void generateSupportBlocks(FVMesh& result); //!< main function of this class
         // void generateSupportBlocks_HE_Mesh(vector<HE_Mesh>& result); //!< main function of this class
 
-        void rebaseSupportBlocksOnModel(FVMesh& result); //!< does something similar to subtracting the model solid from the support block solid
-
         static void test(PrintObject* model);
     protected:
 
@@ -47,6 +46,8 @@ class SupportBlockGenerator
     private:
         void groupOverhangAreas(vector<HE_Mesh>& result); //!< makes new (incomplete!) meshes for each connected group of overhang
 
+        void computeSupportBottoms(); //!< computes vertex_bottom_z by casting rays downward onto the model
+
         inline void supportFace(int f, FVMesh& result);
         inline void supportEdge(int e, FVMesh& result);
         inline void supportVert(int v, FVMesh& result);
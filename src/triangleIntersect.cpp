@@ -1,5 +1,19 @@
 #include "triangleIntersect.h"
 
+#include <algorithm> // max
+#include <math.h> // fabsf, sqrt, lround
+#include <random> // mt19937 (test)
+
+#include "utils/predicates.h" // Orient3dPlane
+
+// the AVX2 kernels are compiled regardless of the -m flags of the build and are only used when the processor supports them
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define TRIANGLE_INTERSECT_AVX2 1
+#   include <immintrin.h> // AVX2 gathers and compares
+#else
+#   define TRIANGLE_INTERSECT_AVX2 0
+#endif
+
 
 void TriangleIntersectionComputation::test()
 {
@@ -52,11 +66,223 @@ void TriangleIntersectionComputation::test()
     TRIANGLE_INTERSECT_DEBUG_PRINTLN("''======================================================================");
 }
 
+void TriangleIntersectionComputation::testRemoveSeparatedByPlanes()
+{
+    std::cerr << " TEST removeSeparatedByPlanes on slivers... " << std::endl;
+
+    // pairs of a sliver of 100 mm by 20 micron and a small triangle which lies a few micron from the plane of the sliver
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> random(-1, 1);
+    auto randomUnitVector = [&](double* v)
+    {
+        double size2;
+        do
+        {
+            for (int d = 0; d < 3; d++)
+                v[d] = random(rng);
+            size2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+        } while (size2 > 1 || size2 < .01);
+        for (int d = 0; d < 3; d++)
+            v[d] /= sqrt(size2);
+    };
+    HE_Mesh slivers;
+    HE_Mesh others;
+    int n_pairs = 100000;
+    for (int p = 0; p < n_pairs; p++)
+    {
+        double u[3], v[3], w[3]; // along the sliver, across the sliver and normal to it
+        randomUnitVector(u);
+        randomUnitVector(w);
+        double dot = u[0] * w[0] + u[1] * w[1] + u[2] * w[2];
+        for (int d = 0; d < 3; d++)
+            w[d] -= dot * u[d];
+        double size = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+        for (int d = 0; d < 3; d++)
+            w[d] /= size;
+        v[0] = w[1] * u[2] - w[2] * u[1];
+        v[1] = w[2] * u[0] - w[0] * u[2];
+        v[2] = w[0] * u[1] - w[1] * u[0];
+        Point3 a(lround(random(rng) * 100000), lround(random(rng) * 100000), lround(random(rng) * 100000));
+        auto at = [&](double along, double across, double normal)
+        {
+            return a + Point3(lround(u[0] * along + v[0] * across + w[0] * normal), lround(u[1] * along + v[1] * across + w[1] * normal), lround(u[2] * along + v[2] * across + w[2] * normal));
+        };
+        slivers.vertices.emplace_back(a, -1);
+        slivers.vertices.emplace_back(at(100000, 0, 0), -1);
+        slivers.vertices.emplace_back(at(random(rng) * 100000, 20, 0), -1);
+        slivers.createFace(3 * p, 3 * p + 1, 3 * p + 2);
+        double along = random(rng) * 100000;
+        for (int i = 0; i < 3; i++)
+            others.vertices.emplace_back(at(along + random(rng) * 1000, random(rng) * 1000, random(rng) * 10 + ((i == 0)? 15 : -5)), -1);
+        others.createFace(3 * p, 3 * p + 1, 3 * p + 2);
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> face_pairs;
+    for (int p = 0; p < n_pairs; p++)
+        face_pairs.emplace_back(p, p);
+    removeSeparatedByPlanes(slivers.getFaceAttributes(), others.getFaceAttributes(), face_pairs);
+
+    std::vector<bool> kept(n_pairs, false);
+    for (const std::pair<uint32_t, uint32_t>& face_pair : face_pairs)
+        kept[face_pair.first] = true;
+    int n_intersecting = 0;
+    int n_lost = 0;
+    for (int p = 0; p < n_pairs; p++)
+    {
+        std::vector<TriangleIntersection> line_segments;
+        IntersectionType type = intersect(HE_FaceHandle(slivers, p), HE_FaceHandle(others, p), line_segments);
+        if (type == IntersectionType::NON_TOUCHING_PLANES) continue;
+        n_intersecting += type == IntersectionType::LINE_SEGMENT;
+        n_lost += !kept[p];
+    }
+    std::cerr << " kept " << face_pairs.size() << " of " << n_pairs << " pairs, of which " << n_intersecting << " intersect; "
+        << n_lost << " pairs removed which aren't separated by a plane" << ((n_lost > 0)? " FAILED!" : "") << std::endl;
+}
+
 std::shared_ptr<TriangleIntersection> TriangleIntersectionComputation::intersect(HE_FaceHandle fh1, HE_FaceHandle fh2)
 {
     return intersect(fh1, fh2, boost::none);
 }
 std::shared_ptr<TriangleIntersection> TriangleIntersectionComputation::intersect(HE_FaceHandle fh1, HE_FaceHandle fh2, boost::optional<Point> some_point_on_planes_intersection_line)
+{
+    boost::optional<TriangleIntersection> result;
+    IntersectionType type = computeIntersection(fh1, fh2, some_point_on_planes_intersection_line, result);
+    if (result)
+        return std::make_shared<TriangleIntersection>(std::move(*result));
+    return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, type);
+}
+IntersectionType TriangleIntersectionComputation::intersect(HE_FaceHandle fh1, HE_FaceHandle fh2, std::vector<TriangleIntersection>& line_segments)
+{
+    boost::optional<TriangleIntersection> result;
+    IntersectionType type = computeIntersection(fh1, fh2, boost::none, result);
+    if (result)
+        line_segments.push_back(std::move(*result));
+    return type;
+}
+/*!
+Whether the vertices of face \p fa of \p a all lie on the same side of the plane of face \p fb of \p b, further than their margin away from it.
+Faces without a proper normal are never separated.
+
+The margin of a vertex is \p margin, for the rounding of the coordinates and of the distance itself,
+plus the normal_error of \p fb times the distance of the vertex to the first vertex of \p fb, on which the offset of the plane is based:
+that is how far the rounded normal may tilt the distance away from the exact one.
+*/
+static inline bool allOnOneSide(const HE_FaceAttributes& a, uint32_t fa, const HE_FaceAttributes& b, uint32_t fb, float margin)
+{
+    int above = 0;
+    int below = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        float dist = b.normal_x[fb] * a.x[i][fa] + b.normal_y[fb] * a.y[i][fa] + b.normal_z[fb] * a.z[i][fa] + b.offset[fb];
+        float vertex_margin = margin + b.normal_error[fb] * (fabsf(a.x[i][fa] - b.x[0][fb]) + fabsf(a.y[i][fa] - b.y[0][fb]) + fabsf(a.z[i][fa] - b.z[0][fb]));
+        above += dist > vertex_margin;
+        below += dist < -vertex_margin;
+    }
+    return above == 3 || below == 3;
+}
+
+#if TRIANGLE_INTERSECT_AVX2 == 1
+//! allOnOneSide for 8 pairs of faces at once; returns all bits set in the lanes for which it holds
+__attribute__((target("avx2")))
+static inline __m256 allOnOneSide8(const HE_FaceAttributes& a, __m256i fa, const HE_FaceAttributes& b, __m256i fb, __m256 margin)
+{
+    __m256 normal_x = _mm256_i32gather_ps(b.normal_x.data(), fb, 4);
+    __m256 normal_y = _mm256_i32gather_ps(b.normal_y.data(), fb, 4);
+    __m256 normal_z = _mm256_i32gather_ps(b.normal_z.data(), fb, 4);
+    __m256 offset = _mm256_i32gather_ps(b.offset.data(), fb, 4);
+    __m256 normal_error = _mm256_i32gather_ps(b.normal_error.data(), fb, 4);
+    __m256 origin_x = _mm256_i32gather_ps(b.x[0].data(), fb, 4);
+    __m256 origin_y = _mm256_i32gather_ps(b.y[0].data(), fb, 4);
+    __m256 origin_z = _mm256_i32gather_ps(b.z[0].data(), fb, 4);
+    __m256 sign_bit = _mm256_set1_ps(-0.f);
+    __m256 all_above = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    __m256 all_below = all_above;
+    for (int i = 0; i < 3; i++)
+    {
+        __m256 x = _mm256_i32gather_ps(a.x[i].data(), fa, 4);
+        __m256 y = _mm256_i32gather_ps(a.y[i].data(), fa, 4);
+        __m256 z = _mm256_i32gather_ps(a.z[i].data(), fa, 4);
+        __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(normal_x, x),
+                _mm256_mul_ps(normal_y, y)),
+                _mm256_mul_ps(normal_z, z)),
+            offset);
+        __m256 distance_to_origin = _mm256_add_ps(_mm256_add_ps( // the L1 distance, computed as in allOnOneSide
+                _mm256_andnot_ps(sign_bit, _mm256_sub_ps(x, origin_x)),
+                _mm256_andnot_ps(sign_bit, _mm256_sub_ps(y, origin_y))),
+                _mm256_andnot_ps(sign_bit, _mm256_sub_ps(z, origin_z)));
+        __m256 vertex_margin = _mm256_add_ps(margin, _mm256_mul_ps(normal_error, distance_to_origin));
+        all_above = _mm256_and_ps(all_above, _mm256_cmp_ps(dist, vertex_margin, _CMP_GT_OQ));
+        all_below = _mm256_and_ps(all_below, _mm256_cmp_ps(dist, _mm256_xor_ps(sign_bit, vertex_margin), _CMP_LT_OQ));
+    }
+    return _mm256_or_ps(all_above, all_below);
+}
+
+/*!
+The part of removeSeparatedByPlanes which handles 8 pairs at once.
+The kept pairs are moved to the front of \p face_pairs and counted in \p n_kept.
+\return the number of pairs handled, a multiple of 8; the remaining pairs are left to the scalar loop
+*/
+__attribute__((target("avx2")))
+static size_t removeSeparatedByPlanes8(const HE_FaceAttributes& planes1, const HE_FaceAttributes& planes2, std::vector<std::pair<uint32_t, uint32_t>>& face_pairs, float margin, size_t& n_kept)
+{
+    __m256 margin8 = _mm256_set1_ps(margin);
+    size_t p = 0;
+    for (; p + 8 <= face_pairs.size(); p += 8)
+    {
+        alignas(32) int32_t faces1[8];
+        alignas(32) int32_t faces2[8];
+        for (int lane = 0; lane < 8; lane++)
+        {
+            faces1[lane] = face_pairs[p + lane].first;
+            faces2[lane] = face_pairs[p + lane].second;
+        }
+        __m256i fa = _mm256_load_si256(reinterpret_cast<const __m256i*>(faces1));
+        __m256i fb = _mm256_load_si256(reinterpret_cast<const __m256i*>(faces2));
+        __m256 separated = _mm256_or_ps(allOnOneSide8(planes1, fa, planes2, fb, margin8), allOnOneSide8(planes2, fb, planes1, fa, margin8));
+        int separated_lanes = _mm256_movemask_ps(separated);
+        for (int lane = 0; lane < 8; lane++)
+        {
+            if (!(separated_lanes & (1 << lane)))
+                face_pairs[n_kept++] = face_pairs[p + lane];
+        }
+    }
+    return p;
+}
+#endif // TRIANGLE_INTERSECT_AVX2 == 1
+
+void TriangleIntersectionComputation::removeSeparatedByPlanes(const HE_FaceAttributes& planes1, const HE_FaceAttributes& planes2, std::vector<std::pair<uint32_t, uint32_t>>& face_pairs)
+{
+    float margin = plane_side_margin * std::max(planes1.max_coord, planes2.max_coord);
+    size_t n_kept = 0;
+    size_t p = 0;
+#if TRIANGLE_INTERSECT_AVX2 == 1
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+        p = removeSeparatedByPlanes8(planes1, planes2, face_pairs, margin, n_kept);
+#endif // TRIANGLE_INTERSECT_AVX2 == 1
+    for (; p < face_pairs.size(); p++)
+    {
+        const std::pair<uint32_t, uint32_t>& pair = face_pairs[p];
+        if (!allOnOneSide(planes1, pair.first, planes2, pair.second, margin) && !allOnOneSide(planes2, pair.second, planes1, pair.first, margin))
+            face_pairs[n_kept++] = pair;
+    }
+    face_pairs.resize(n_kept);
+}
+
+/*!
+Where the segment from a to b crosses a plane, as the fraction of the way from a to b, given the signed distances \p da and \p db of a and b to the plane.
+The sides of a and b are decided exactly, but the distances are rounded, so they may not differ in sign; the fraction is then clamped to the segment.
+*/
+static inline xType crossingFraction(float da, float db)
+{
+    xType fraction = da / xType(da - db);
+    if (!(fraction > 0)) return 0; // also when both distances rounded to zero
+    if (fraction > 1) return 1;
+    return fraction;
+}
+
+IntersectionType TriangleIntersectionComputation::computeIntersection(HE_FaceHandle fh1, HE_FaceHandle fh2, boost::optional<Point> some_point_on_planes_intersection_line, boost::optional<TriangleIntersection>& result)
 {
     TRIANGLE_INTERSECT_DEBUG_PRINTLN("intersecting");
     //! see Tomas Moller - A Fast Triangle-Triangle Intersection Test
@@ -75,42 +301,29 @@ std::shared_ptr<TriangleIntersection> TriangleIntersectionComputation::intersect
 
     TRIANGLE_INTERSECT_DEBUG_PRINTLN("init finished");
 
-    FPoint ab1 = b1-a1;
-    FPoint ac1 = c1-a1;
-
-    FPoint ab2 = b2-a2;
-    FPoint ac2 = c2-a2;
-
-    FPoint n1u = ab1.cross(ac1);
-    FPoint n2u = ab2.cross(ac2);
-    FPoint n1 = n1u.normalized();
-    FPoint n2 = n2u.normalized();
-
-    TRIANGLE_INTERSECT_DEBUG_SHOW(n1);
-    TRIANGLE_INTERSECT_DEBUG_SHOW(n2);
-    TRIANGLE_INTERSECT_DEBUG_SHOW(a1);
-    TRIANGLE_INTERSECT_DEBUG_SHOW(a2);
-
-    auto resizeNormal = [](FPoint& n) { while (n.vSize2() > 100000 )    n *= .5; };
-
-
-    float d1 = n1.dot(a1) * -1;
-    TRIANGLE_INTERSECT_DEBUG_SHOW(d1);
-    float d2 = n2.dot(a2) * -1;
-    TRIANGLE_INTERSECT_DEBUG_SHOW(d2);
-
-    auto dp1 = [&](FPoint& a) { return n1.dot(a) + d1; }; // distance to plane 2
-    auto dp2 = [&](FPoint& a) { return n2.dot(a) + d2; }; // distance to plane 1
-
-    auto sign = [](float a) { return char((0<a) - (a<0)); };
-
-    char sa1 = sign(dp2(a1)); // sign of the distance
-    char sb1 = sign(dp2(b1));
-    char sc1 = sign(dp2(c1));
+    Point3 pa1 = fh1.p0();
+    Point3 pb1 = fh1.p1();
+    Point3 pc1 = fh1.p2();
+    Point3 pa2 = fh2.p0();
+    Point3 pb2 = fh2.p1();
+    Point3 pc2 = fh2.p2();
+
+    // the sides are determined exactly on the integer coordinates, so that they are consistent for all faces sharing a vertex
+    Orient3dPlane plane2(pa2, pb2, pc2);
+    char sa1 = plane2.side(pa1);
+    char sb1 = plane2.side(pb1);
+    char sc1 = plane2.side(pc1);
+
+    if (sa1 == sb1 && sb1 == sc1 && sa1 != 0)
+    { // early reject, before computing anything of the first triangle's plane: this is the case for most pairs with overlapping bounding boxes
+        TRIANGLE_INTERSECT_DEBUG_PRINTLN(" no intersection! " << sa1);
+        return IntersectionType::NON_TOUCHING_PLANES;
+    }
 
-    char sa2 = sign(dp1(a2));
-    char sb2 = sign(dp1(b2));
-    char sc2 = sign(dp1(c2));
+    Orient3dPlane plane1(pa1, pb1, pc1);
+    char sa2 = plane1.side(pa2);
+    char sb2 = plane1.side(pb2);
+    char sc2 = plane1.side(pc2);
 
     TRIANGLE_INTERSECT_DEBUG_SHOW(int(sa1));
     TRIANGLE_INTERSECT_DEBUG_SHOW(int(sb1));
@@ -119,38 +332,53 @@ std::shared_ptr<TriangleIntersection> TriangleIntersectionComputation::intersect
     TRIANGLE_INTERSECT_DEBUG_SHOW(int(sb2));
     TRIANGLE_INTERSECT_DEBUG_SHOW(int(sc2));
 
-
-    if (n1 == n2 || n1 == -n2)
+    if (sa1 == 0 && sb1 == 0 && sc1 == 0 && sa2 == 0 && sb2 == 0 && sc2 == 0)
     {
-        if (sa1 == 0)
-        {
-            TRIANGLE_INTERSECT_DEBUG_PRINTLN("coplanar triangles!");
-            return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, IntersectionType::COPLANAR); // parallel triangles! (also in the coplanar case we don't do anything)
-        }
-        TRIANGLE_INTERSECT_DEBUG_PRINTLN("parallel triangles!");
-        return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, IntersectionType::PARALLEL); // parallel triangles! (also in the coplanar case we don't do anything)
+        TRIANGLE_INTERSECT_DEBUG_PRINTLN("coplanar triangles!");
+        return IntersectionType::COPLANAR; // (in the coplanar case we don't do anything)
     }
-
     if (sa1 == sb1 && sb1 == sc1)
     {
-        TRIANGLE_INTERSECT_DEBUG_PRINTLN(" no intersection, or coplanar! " << sa1);
-        TRIANGLE_INTERSECT_DEBUG_PRINTLN(dp2(a1) << "," << dp2(b1) << ","<< dp2(c1));
-        return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, IntersectionType::NON_TOUCHING_PLANES); // no intersection (sign >0 or <0), or coplanar (sign=0)!
+        TRIANGLE_INTERSECT_DEBUG_PRINTLN(" no intersection, or degenerate triangle 2! " << sa1);
+        return IntersectionType::NON_TOUCHING_PLANES; // all of triangle 1 lies in plane 2, but triangle 2 doesn't lie in plane 1
     }
     if (sa2 == sb2 && sb2 == sc2)
     {
         TRIANGLE_INTERSECT_DEBUG_PRINTLN(" no intersection! ");
-        return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, IntersectionType::NON_TOUCHING_PLANES); // no intersection
+        return IntersectionType::NON_TOUCHING_PLANES; // no intersection
+    }
+
+    FPoint n2; // normal of triangle 2
+    float d2;
+    fh2.plane(n2, d2); // cached in the mesh, or computed from a2, b2 and c2
+    auto dp2 = [&](FPoint& a) { return n2.dot(a) + d2; }; // distance to plane 2
+
+    FPoint n1;
+    float d1;
+    fh1.plane(n1, d1);
+    auto dp1 = [&](FPoint& a) { return n1.dot(a) + d1; }; // distance to plane 1
+
+    TRIANGLE_INTERSECT_DEBUG_SHOW(n1);
+    TRIANGLE_INTERSECT_DEBUG_SHOW(n2);
+    TRIANGLE_INTERSECT_DEBUG_SHOW(a1);
+    TRIANGLE_INTERSECT_DEBUG_SHOW(a2);
+    TRIANGLE_INTERSECT_DEBUG_SHOW(d1);
+    TRIANGLE_INTERSECT_DEBUG_SHOW(d2);
+
+    if (n1 == n2 || n1 == -n2)
+    {
+        TRIANGLE_INTERSECT_DEBUG_PRINTLN("parallel triangles!");
+        return IntersectionType::PARALLEL; // the planes do cross, but at an angle too small to compute the direction of their intersection in floats
     }
 
     FPoint O;
 
 
     TrianglePlaneIntersection tri1_plane2_ints = getIntersectingEdges(a1,b1,c1,sa1,sb1,sc1, fh1);
-    if (! tri1_plane2_ints.isCorrect) return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, tri1_plane2_ints.intersectionType);
+    if (! tri1_plane2_ints.isCorrect) return tri1_plane2_ints.intersectionType;
 
     TrianglePlaneIntersection tri2_plane1_ints = getIntersectingEdges(a2,b2,c2,sa2,sb2,sc2, fh2);
-    if (! tri2_plane1_ints.isCorrect) return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, tri2_plane1_ints.intersectionType);
+    if (! tri2_plane1_ints.isCorrect) return tri2_plane1_ints.intersectionType;
 
 
 
@@ -200,7 +428,7 @@ TRIANGLE_INTERSECT_DEBUG_PRINTLN(" ");
         {
             float pLa = pL(a);
             float pLb = pL(b);
-            return pLa + (pLb - pLa) * dp2(a) / xType(dp2(a) - dp2(b));
+            return pLa + (pLb - pLa) * crossingFraction(dp2(a), dp2(b));
         }; // intersect line from plane 1 with plane 2
     auto i2 = [&](FPoint& a, FPoint& b)
         {
@@ -208,7 +436,7 @@ TRIANGLE_INTERSECT_DEBUG_PRINTLN(" ");
             TRIANGLE_INTERSECT_DEBUG_PRINTLN("  namely for "<<a << " , "<<b);
             float pLa = pL(a);
             float pLb = pL(b);
-            return pLa + (pLb - pLa) * dp1(a) / xType(dp1(a) - dp1(b));
+            return pLa + (pLb - pLa) * crossingFraction(dp1(a), dp1(b));
         }; // intersect line from plane 2 with plane 1
 
 
@@ -285,13 +513,13 @@ TRIANGLE_INTERSECT_DEBUG_PRINTLN("p22 = " << tri2_plane1_ints.line2.intersection
     if (x12 < x21 || x22 < x11)
     {
         TRIANGLE_INTERSECT_DEBUG_PRINTLN("no overlap between line segments of intersections of triangles in the plane of the other !");
-        return std::make_shared<TriangleIntersection>(nullptr, nullptr, false, false, IntersectionType::NON_TOUCHING); // no overlap!
+        return IntersectionType::NON_TOUCHING; // no overlap!
     }
 
 
 
     //return TriangleIntersection((x11 > x21)? tri1_plane2_ints.line1.intersection : tri2_plane1_ints.line1.intersection, (x12 < x22)? tri1_plane2_ints.line2.intersection : tri2_plane1_ints.line2.intersection);
-    std::shared_ptr<TriangleIntersection> ret = std::make_shared<TriangleIntersection>(
+    result.emplace(
               std::move(( (x11 > x21)? tri1_plane2_ints : tri2_plane1_ints ).line1.intersection)
             , std::move(( (x12 < x22)? tri1_plane2_ints : tri2_plane1_ints ).line2.intersection)
             , tri1_plane2_ints.isDirectionOfInnerFacePart
@@ -300,44 +528,46 @@ TRIANGLE_INTERSECT_DEBUG_PRINTLN("p22 = " << tri2_plane1_ints.line2.intersection
             , tri2_plane1_ints.edgeOfTriangleTouchesPlane
             , IntersectionType::LINE_SEGMENT
         );
+    TriangleIntersection& ret = *result;
 
-    if ( ( ret->from->p() - ret->to->p() ) .testLength(MELD_DISTANCE))
+    if ( ( ret.from->p() - ret.to->p() ) .testLength(MELD_DISTANCE))
     { // only return resulting line segment if it contains a vertex and another point (which is not the same vertex)
-        if (ret->to->getType() == IntersectionPointType::NEW && ret->from->getType() == IntersectionPointType::NEW)
+        if (ret.to->getType() == IntersectionPointType::NEW && ret.from->getType() == IntersectionPointType::NEW)
         {
             TRIANGLE_INTERSECT_DEBUG_PRINTLN("intersection vertices quite close to eachother! (ignoring...)");
             //return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, TOUCHING);
         }
-        if (ret->to->getType() == IntersectionPointType::VERTEX && ret->from->getType() == IntersectionPointType::VERTEX)
-            if (ret->to->vertex == ret->from->vertex  )
+        if (ret.to->getType() == IntersectionPointType::VERTEX && ret.from->getType() == IntersectionPointType::VERTEX)
+            if (ret.to->vertex == ret.from->vertex  )
             {
                 TRIANGLE_INTERSECT_DEBUG_PRINTLN("triangle intersections is vertex point only!");
-                return std::make_shared<TriangleIntersection>(boost::none, boost::none, false, false, IntersectionType::TOUCHING_POINT);
+                result = boost::none;
+                return IntersectionType::TOUCHING_POINT;
             }
 
     }
-    if (ret->from->type == IntersectionPointType::NEW)
+    if (ret.from->type == IntersectionPointType::NEW)
     {
-             if ( ( ret->from->p() - fh1.p0() ) .testLength(MELD_DISTANCE)) ret->from = IntersectionPoint(fh1.v0());
-        else if ( ( ret->from->p() - fh1.p1() ) .testLength(MELD_DISTANCE)) ret->from = IntersectionPoint(fh1.v1());
-        else if ( ( ret->from->p() - fh1.p2() ) .testLength(MELD_DISTANCE)) ret->from = IntersectionPoint(fh1.v2());
-        else if ( ( ret->from->p() - fh2.p0() ) .testLength(MELD_DISTANCE)) ret->from = IntersectionPoint(fh2.v0());
-        else if ( ( ret->from->p() - fh2.p1() ) .testLength(MELD_DISTANCE)) ret->from = IntersectionPoint(fh2.v1());
-        else if ( ( ret->from->p() - fh2.p2() ) .testLength(MELD_DISTANCE)) ret->from = IntersectionPoint(fh2.v2());
+             if ( ( ret.from->p() - fh1.p0() ) .testLength(MELD_DISTANCE)) ret.from = IntersectionPoint(fh1.v0());
+        else if ( ( ret.from->p() - fh1.p1() ) .testLength(MELD_DISTANCE)) ret.from = IntersectionPoint(fh1.v1());
+        else if ( ( ret.from->p() - fh1.p2() ) .testLength(MELD_DISTANCE)) ret.from = IntersectionPoint(fh1.v2());
+        else if ( ( ret.from->p() - fh2.p0() ) .testLength(MELD_DISTANCE)) ret.from = IntersectionPoint(fh2.v0());
+        else if ( ( ret.from->p() - fh2.p1() ) .testLength(MELD_DISTANCE)) ret.from = IntersectionPoint(fh2.v1());
+        else if ( ( ret.from->p() - fh2.p2() ) .testLength(MELD_DISTANCE)) ret.from = IntersectionPoint(fh2.v2());
     }
-    if (ret->to->type == IntersectionPointType::NEW)
+    if (ret.to->type == IntersectionPointType::NEW)
     {
-             if ( ( ret->to->p() - fh1.p0() ) .testLength(MELD_DISTANCE)) ret->to = IntersectionPoint(fh1.v0());
-        else if ( ( ret->to->p() - fh1.p1() ) .testLength(MELD_DISTANCE)) ret->to = IntersectionPoint(fh1.v1());
-        else if ( ( ret->to->p() - fh1.p2() ) .testLength(MELD_DISTANCE)) ret->to = IntersectionPoint(fh1.v2());
-        else if ( ( ret->to->p() - fh2.p0() ) .testLength(MELD_DISTANCE)) ret->to = IntersectionPoint(fh2.v0());
-        else if ( ( ret->to->p() - fh2.p1() ) .testLength(MELD_DISTANCE)) ret->to = IntersectionPoint(fh2.v1());
-        else if ( ( ret->to->p() - fh2.p2() ) .testLength(MELD_DISTANCE)) ret->to = IntersectionPoint(fh2.v2());
+             if ( ( ret.to->p() - fh1.p0() ) .testLength(MELD_DISTANCE)) ret.to = IntersectionPoint(fh1.v0());
+        else if ( ( ret.to->p() - fh1.p1() ) .testLength(MELD_DISTANCE)) ret.to = IntersectionPoint(fh1.v1());
+        else if ( ( ret.to->p() - fh1.p2() ) .testLength(MELD_DISTANCE)) ret.to = IntersectionPoint(fh1.v2());
+        else if ( ( ret.to->p() - fh2.p0() ) .testLength(MELD_DISTANCE)) ret.to = IntersectionPoint(fh2.v0());
+        else if ( ( ret.to->p() - fh2.p1() ) .testLength(MELD_DISTANCE)) ret.to = IntersectionPoint(fh2.v1());
+        else if ( ( ret.to->p() - fh2.p2() ) .testLength(MELD_DISTANCE)) ret.to = IntersectionPoint(fh2.v2());
     }
 
     TRIANGLE_INTERSECT_DEBUG_PRINTLN("finished!");
 
-    return ret;
+    return IntersectionType::LINE_SEGMENT;
 }
 
 
@@ -12,6 +12,7 @@
 #include <memory> // unique_ptr
 
 #include <cstdlib> // exit (debug only)
+#include <vector>
 
 #include "MACROS.h" // ENUM
 
@@ -238,9 +239,43 @@ class TriangleIntersectionComputation
 public:
     static std::shared_ptr<TriangleIntersection> intersect(HE_FaceHandle fh1, HE_FaceHandle fh2);
     static std::shared_ptr<TriangleIntersection> intersect(HE_FaceHandle fh1, HE_FaceHandle fh2, boost::optional<Point> some_point_on_planes_intersection_line);
+    /*!
+    Same as above, but without allocating anything for pairs of triangles which don't intersect in a line segment.
+
+    Most pairs are rejected by the signs of the distances of the vertices of the one triangle to the plane of the other,
+    so only the type of (non-)intersection is returned; the intersection itself is only constructed for actual line segments.
+
+    \param line_segments output: the intersection is appended to it if it is a line segment
+    \return the type of (non-)intersection
+    */
+    static IntersectionType intersect(HE_FaceHandle fh1, HE_FaceHandle fh2, std::vector<TriangleIntersection>& line_segments);
+
+    /*!
+    Remove the pairs of faces of which the vertices of one face all lie on the same side of the plane of the other face.
+    These are the early rejections of intersect(.), but evaluated for 8 pairs at once when the processor supports AVX2.
+
+    intersect(.) decides the sides exactly, but here the distances are computed in floats from the cached unit normals.
+    So a vertex has to lie further from the plane than a margin which bounds the difference between the two:
+    a fixed part for the rounding of the coordinates and the distance (see plane_side_margin),
+    plus the error of the rounded normal of the face (see HE_FaceAttributes::normalError) times the distance of the vertex to the face.
+    Thin faces thus get larger margins, and every pair for which intersect(.) might find anything else than a non-intersection is kept.
+
+    \param planes1 the face attributes of the mesh of the first faces (see HE_Mesh::getFaceAttributes)
+    \param planes2 the face attributes of the mesh of the second faces
+    \param face_pairs the pairs of indices of faces of \p planes1 and \p planes2; the remaining pairs keep their order
+    */
+    static void removeSeparatedByPlanes(const HE_FaceAttributes& planes1, const HE_FaceAttributes& planes2, std::vector<std::pair<uint32_t, uint32_t>>& face_pairs);
 
     static void test();
+    static void testRemoveSeparatedByPlanes(); //!< checks on slivers that removeSeparatedByPlanes only removes pairs which intersect(.) rejects on the sides of their planes
 protected:
+    /*!
+    Compute the intersection between two triangles.
+    \param result output: set to the intersection when it is a line segment; left untouched otherwise
+    \return the type of (non-)intersection
+    */
+    static IntersectionType computeIntersection(HE_FaceHandle fh1, HE_FaceHandle fh2, boost::optional<Point> some_point_on_planes_intersection_line, boost::optional<TriangleIntersection>& result);
+
     /*!
     A line segment corresponding to an edge of the one triangle crossing the halfplane of the other triangle.
     The intersection point at which the line intersects the halfplane is also stored.
@@ -309,6 +344,8 @@ protected:
     */
     static TrianglePlaneIntersection getIntersectingEdges(FPoint3& a, FPoint3& b, FPoint3& c, char sa, char sb, char sc, HE_FaceHandle fh);
     static xType divide(FPoint a, FPoint& b); //!< divide two vectors, assuming they are in the same direction
+
+    static constexpr float plane_side_margin = 1e-5; //!< the fixed part of the margin of removeSeparatedByPlanes, relative to the largest coordinate; about 170 times the rounding error of a float
 };
 
 
@@ -0,0 +1,134 @@
+#ifndef BLOCKPOOL_H
+#define BLOCKPOOL_H
+
+#include <stddef.h>
+#include <new> // placement new, operator new
+#include <utility> // forward, swap
+#include <vector>
+
+/*!
+Chunked arena with stable element addresses.
+
+Elements are stored in fixed-size blocks which are never moved or reallocated,
+so that pointers and references to elements stay valid when elements are added
+(in contrast to a std::vector). Only clear() and destruction invalidate them.
+
+The interface is the subset of std::vector which is used by the meshes, so it can be used as their element container.
+Elements can be accessed by index, but there is no erase; this is a pool for graph structures which only grow.
+
+\tparam T the element type
+\tparam block_size the number of elements per block
+*/
+template<typename T, size_t block_size = 4096>
+class BlockPool
+{
+    std::vector<T*> blocks; //!< all allocated blocks; the elements fill them in order, reserved blocks at the end may be empty
+    size_t n; //!< the number of elements
+
+    T* newBlock()
+    {
+        return static_cast<T*>(::operator new(sizeof(T) * block_size));
+    }
+
+public:
+    typedef T value_type;
+
+    /*!
+    Iterator over all elements, in order of insertion.
+    */
+    template<typename Pool, typename Elem>
+    class Iterator
+    {
+        Pool* pool;
+        size_t idx;
+    public:
+        Iterator(Pool* pool, size_t idx) : pool(pool), idx(idx) {};
+        Elem& operator*() const { return (*pool)[idx]; };
+        Elem* operator->() const { return &(*pool)[idx]; };
+        Iterator& operator++() { idx++; return *this; };
+        bool operator==(const Iterator& other) const { return idx == other.idx; };
+        bool operator!=(const Iterator& other) const { return idx != other.idx; };
+    };
+    typedef Iterator<BlockPool, T> iterator;
+    typedef Iterator<const BlockPool, const T> const_iterator;
+
+    BlockPool() : n(0) {};
+    BlockPool(const BlockPool&) = delete; //!< copying would require remapping all pointers into the pool
+    BlockPool& operator=(const BlockPool&) = delete;
+    BlockPool(BlockPool&& other) : blocks(std::move(other.blocks)), n(other.n) { other.blocks.clear(); other.n = 0; };
+    BlockPool& operator=(BlockPool&& other)
+    {
+        std::swap(blocks, other.blocks);
+        std::swap(n, other.n);
+        return *this;
+    }
+    ~BlockPool()
+    {
+        clear();
+    }
+
+    size_t size() const { return n; };
+    bool empty() const { return n == 0; };
+
+    T& operator[](size_t idx) { return blocks[idx / block_size][idx % block_size]; };
+    const T& operator[](size_t idx) const { return blocks[idx / block_size][idx % block_size]; };
+
+    T& back() { return (*this)[n - 1]; };
+    const T& back() const { return (*this)[n - 1]; };
+
+    iterator begin() { return iterator(this, 0); };
+    iterator end() { return iterator(this, n); };
+    const_iterator begin() const { return const_iterator(this, 0); };
+    const_iterator end() const { return const_iterator(this, n); };
+
+    /*!
+    Allocate the blocks needed to store \p n_total elements, so that adding them doesn't allocate memory anymore.
+    */
+    void reserve(size_t n_total)
+    {
+        size_t n_blocks = (n_total + block_size - 1) / block_size;
+        blocks.reserve(n_blocks);
+        while (blocks.size() < n_blocks)
+        {
+            blocks.push_back(newBlock());
+        }
+    }
+
+    /*!
+    Construct a new element at the end of the pool.
+    \return the new element
+    */
+    template<typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (n == blocks.size() * block_size)
+        {
+            blocks.push_back(newBlock());
+        }
+        T* elem = &blocks[n / block_size][n % block_size];
+        new (elem) T(std::forward<Args>(args)...);
+        n++;
+        return *elem;
+    }
+
+    void push_back(const T& elem) { emplace_back(elem); };
+
+    /*!
+    Destroy all elements and free all blocks.
+    */
+    void clear()
+    {
+        for (size_t idx = 0; idx < n; idx++)
+        {
+            (*this)[idx].~T();
+        }
+        for (T* block : blocks)
+        {
+            ::operator delete(block);
+        }
+        blocks.clear();
+        n = 0;
+    }
+};
+
+#endif // BLOCKPOOL_H
@@ -0,0 +1,3 @@
+#include "BucketGrid3D.h"
+
+// used so that the header will get recompiled when changed
@@ -0,0 +1,107 @@
+#ifndef BUCKET_GRID_3D_H
+#define BUCKET_GRID_3D_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm> // sort
+
+#include "intpoint.h" // Point3
+#include "../mesh/VertexHashTable.h"
+
+/*!
+Spatial hash for finding the objects located within some distance of a point.
+
+The objects and their locations are stored in flat arrays in order of insertion.
+The cells are kept in a VertexHashTable, which maps each cell to the indices of the objects in it, so a query inspects only the 2x2x2 cells nearest to the query point.
+
+Results are ordered on insertion index, so they don't depend on the layout of the table.
+*/
+template<typename T>
+class BucketGrid3D
+{
+    VertexHashTable table; //!< maps the cells to the indices into points and objects
+    std::vector<Point3> points; //!< the location of each object
+    std::vector<T> objects; //!< all objects in order of insertion
+public:
+    /*!
+    \param max_distance the distance within which objects are considered close to a point (e.g. MELD_DISTANCE)
+    */
+    BucketGrid3D(spaceType max_distance)
+    : table(max_distance)
+    {
+    }
+
+    void reserve(size_t n_objects) //!< make sure \p n_objects can be inserted without rehashing
+    {
+        table.reserve(n_objects);
+        points.reserve(n_objects);
+        objects.reserve(n_objects);
+    }
+
+    size_t size() const { return objects.size(); }
+
+    void insert(const Point3& p, const T& t) //!< register that \p t is located at \p p
+    {
+        table.insert(p, points.size());
+        points.push_back(p);
+        objects.push_back(t);
+    }
+
+    /*!
+    Find all objects within the max distance of \p p.
+    \param ret output: the objects found, in order of insertion; the vector is not cleared first
+    \return whether any object was found
+    */
+    bool findCloseObjects(const Point3& p, std::vector<T>& ret) const
+    {
+        size_t first = ret.size();
+        std::vector<uint32_t> found;
+        forEachClose(p, [&](uint32_t idx, int64_t) { found.push_back(idx); });
+        std::sort(found.begin(), found.end());
+        for (uint32_t idx : found)
+        {
+            ret.push_back(objects[idx]);
+        }
+        return ret.size() > first;
+    }
+
+    /*!
+    Find the object closest to \p p, provided it lies within the max distance.
+    Ties are broken toward the object inserted first.
+    \param nearby output: the object found
+    \return whether any object was found
+    */
+    bool findNearestObject(const Point3& p, T& nearby) const
+    {
+        uint32_t best = UINT32_MAX;
+        int64_t best_dist2 = 0;
+        forEachClose(p, [&](uint32_t idx, int64_t dist2)
+            {
+                if (best == UINT32_MAX || dist2 < best_dist2 || (dist2 == best_dist2 && idx < best))
+                {
+                    best = idx;
+                    best_dist2 = dist2;
+                }
+            });
+        if (best == UINT32_MAX)
+            return false;
+        nearby = objects[best];
+        return true;
+    }
+
+private:
+    //! call \p handle with the index and squared distance of each object within the max distance of \p p
+    template<typename Handle>
+    void forEachClose(const Point3& p, const Handle& handle) const
+    {
+        spaceType max_distance = table.getMeldDistance();
+        table.forEachCandidate(p, [&](uint32_t idx)
+            {
+                Point3 diff = points[idx] - p;
+                if (diff.testLength(max_distance))
+                    handle(idx, diff.vSize2());
+            });
+    }
+};
+
+#endif // BUCKET_GRID_3D_H
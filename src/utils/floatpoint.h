@@ -128,7 +128,7 @@ public:
         m[2][2] = 1.0;
     }
 
-    Point3 apply(FPoint3 p)
+    Point3 apply(FPoint3 p) const
     {
         return Point3(
             MM2INT(p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0]),
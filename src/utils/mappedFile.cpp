@@ -0,0 +1,101 @@
+/** Copyright (C) 2013 David Braam - Released under terms of the AGPLv3 License */
+#include <stdio.h>
+
+#ifdef __WIN32
+#include <stdlib.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mappedFile.h"
+
+MappedFile::MappedFile()
+: data_(nullptr)
+, size_(0)
+, mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* filename)
+{
+    close();
+#ifdef __WIN32
+    FILE* f = fopen(filename, "rb");
+    if (f == nullptr)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0)
+    {
+        fclose(f);
+        return false;
+    }
+    char* buffer = static_cast<char*>(malloc(size > 0 ? size : 1));
+    if (buffer == nullptr || fread(buffer, 1, size, f) != size_t(size))
+    {
+        free(buffer);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    data_ = buffer;
+    size_ = size;
+    mapped = false;
+    return true;
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    size_ = st.st_size;
+    if (size_ == 0)
+    { // mmap doesn't accept empty ranges; an empty file is simply an empty view
+        ::close(fd);
+        data_ = "";
+        mapped = false;
+        return true;
+    }
+    void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (map == MAP_FAILED)
+    {
+        size_ = 0;
+        return false;
+    }
+    madvise(map, size_, MADV_SEQUENTIAL); // we read front to back, so let the kernel read ahead aggressively
+    madvise(map, size_, MADV_WILLNEED);
+    data_ = static_cast<const char*>(map);
+    mapped = true;
+    return true;
+#endif
+}
+
+void MappedFile::close()
+{
+    if (data_ == nullptr)
+        return;
+#ifdef __WIN32
+    free(const_cast<char*>(data_));
+#else
+    if (mapped)
+        munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapped = false;
+}
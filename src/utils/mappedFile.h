@@ -0,0 +1,32 @@
+/** Copyright (C) 2013 David Braam - Released under terms of the AGPLv3 License */
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+/*!
+Read-only view of a whole file in memory.
+
+On POSIX systems the file is memory mapped, so the pages are read on demand straight from the page cache without an intermediate copy.
+Elsewhere the file is read into a single buffer in one go.
+*/
+class MappedFile
+{
+    const char* data_; //!< start of the file contents, or nullptr when nothing is opened
+    size_t size_; //!< the number of bytes in the file
+    bool mapped; //!< whether data_ is a memory map (or a heap buffer)
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char* filename); //!< map the file \p filename, returns false if the file couldn't be opened
+    void close(); //!< release the mapping
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+private:
+    MappedFile(const MappedFile&); //!< not copyable
+    MappedFile& operator=(const MappedFile&); //!< not copyable
+};
+
+#endif//MAPPED_FILE_H
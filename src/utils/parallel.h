@@ -0,0 +1,178 @@
+/** Copyright (C) 2013 David Braam - Released under terms of the AGPLv3 License */
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm> // sort, inplace_merge, stable_partition
+#include <iterator> // iterator_traits
+
+/*!
+Small helpers to spread work over all cores with plain std::threads.
+
+All helpers split the work in contiguous ranges which are processed in order within a thread, so that code which writes its results to a per-range buffer can merge those buffers afterwards in a deterministic order.
+*/
+
+//! The number of threads to use for parallel work: the number of hardware threads, or 1 if that is unknown.
+static inline unsigned int getThreadCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return (n < 1)? 1 : n;
+}
+
+/*!
+Call \p f(range_idx, begin, end) for \p n_ranges consecutive, equally sized ranges covering [0, \p n).
+The ranges are processed concurrently; the call returns when all ranges are done.
+When \p n is smaller than \p min_per_range * 2 everything is processed on the calling thread as a single range.
+*/
+template<typename F>
+void parallelForRanges(size_t n, unsigned int n_ranges, const F& f, size_t min_per_range = 1024)
+{
+    if (n_ranges < 1) n_ranges = 1;
+    if (n < min_per_range * 2) n_ranges = 1;
+    if (n_ranges > n) n_ranges = (n > 0)? n : 1;
+    if (n_ranges == 1)
+    {
+        f(0, 0, n);
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(n_ranges - 1);
+    for (unsigned int r = 1; r < n_ranges; r++)
+    {
+        size_t begin = n * r / n_ranges;
+        size_t end = n * (r + 1) / n_ranges;
+        threads.emplace_back([&f, r, begin, end]() { f(r, begin, end); });
+    }
+    f(0, 0, n / n_ranges); // the calling thread does the first range itself
+    for (std::thread& t : threads)
+        t.join();
+}
+
+//! Call \p f(range_idx, begin, end) for one range of [0, \p n) per hardware thread.
+template<typename F>
+void parallelForRanges(size_t n, const F& f, size_t min_per_range = 1024)
+{
+    parallelForRanges(n, getThreadCount(), f, min_per_range);
+}
+
+//! Call \p f(i) for each i in [0, \p n), spread over all hardware threads.
+template<typename F>
+void parallelFor(size_t n, const F& f, size_t min_per_range = 1024)
+{
+    parallelForRanges(n, [&f](unsigned int, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+                f(i);
+        }, min_per_range);
+}
+
+/*!
+Sort [\p begin, \p end) with \p comp on all hardware threads.
+
+The ranges are sorted concurrently with std::sort and merged pairwise afterwards.
+The result is the same as std::sort for any strict weak ordering in which no two different elements compare equivalent.
+*/
+template<typename Iterator, typename Compare>
+void parallelSort(Iterator begin, Iterator end, const Compare& comp)
+{
+    size_t n = end - begin;
+    unsigned int n_ranges = getThreadCount();
+    if (n < 4096 || n_ranges == 1)
+    {
+        std::sort(begin, end, comp);
+        return;
+    }
+    std::vector<size_t> bounds(n_ranges + 1);
+    for (unsigned int r = 0; r <= n_ranges; r++)
+        bounds[r] = n * r / n_ranges;
+    parallelForRanges(n_ranges, n_ranges, [&](unsigned int, size_t r_begin, size_t r_end)
+        {
+            for (size_t r = r_begin; r < r_end; r++)
+                std::sort(begin + bounds[r], begin + bounds[r + 1], comp);
+        }, 1);
+    while (bounds.size() > 2)
+    { // merge neighbouring pairs of sorted ranges until a single range is left
+        size_t n_merges = (bounds.size() - 1) / 2;
+        parallelForRanges(n_merges, n_merges, [&](unsigned int, size_t m_begin, size_t m_end)
+            {
+                for (size_t m = m_begin; m < m_end; m++)
+                    std::inplace_merge(begin + bounds[m * 2], begin + bounds[m * 2 + 1], begin + bounds[m * 2 + 2], comp);
+            }, 1);
+        std::vector<size_t> merged_bounds;
+        for (size_t b = 0; b < bounds.size(); b += 2)
+            merged_bounds.push_back(bounds[b]);
+        if (merged_bounds.back() != bounds.back())
+            merged_bounds.push_back(bounds.back());
+        bounds.swap(merged_bounds);
+    }
+}
+
+/*!
+Reorder [\p begin, \p end) such that the elements for which \p pred holds come first, keeping the relative order within both groups; the result is the same as that of std::stable_partition.
+
+The elements are classified in \p n_ranges concurrent ranges, after which each range moves its elements directly to their final place via a temporary copy.
+When \p n is smaller than \p min_per_range * 2 std::stable_partition is used.
+\return the first element for which \p pred doesn't hold
+*/
+template<typename Iterator, typename Predicate>
+Iterator parallelStablePartition(Iterator begin, Iterator end, const Predicate& pred, unsigned int n_ranges, size_t min_per_range = 4096)
+{
+    typedef typename std::iterator_traits<Iterator>::value_type T;
+    size_t n = end - begin;
+    if (n < min_per_range * 2 || n_ranges <= 1)
+    {
+        return std::stable_partition(begin, end, pred);
+    }
+    if (n_ranges > n) n_ranges = n;
+
+    std::vector<char> is_true(n);
+    std::vector<size_t> true_count(n_ranges);
+    parallelForRanges(n, n_ranges, [&](unsigned int r, size_t r_begin, size_t r_end)
+        {
+            size_t count = 0;
+            for (size_t i = r_begin; i < r_end; i++)
+            {
+                is_true[i] = pred(begin[i]);
+                count += is_true[i];
+            }
+            true_count[r] = count;
+        }, 1);
+
+    // the place where each range starts writing its elements of both groups
+    std::vector<size_t> true_offset(n_ranges);
+    std::vector<size_t> false_offset(n_ranges);
+    size_t n_true = 0;
+    for (unsigned int r = 0; r < n_ranges; r++)
+    {
+        true_offset[r] = n_true;
+        n_true += true_count[r];
+    }
+    size_t n_false = n_true;
+    for (unsigned int r = 0; r < n_ranges; r++)
+    {
+        false_offset[r] = n_false;
+        n_false += n * (r + 1) / n_ranges - n * r / n_ranges - true_count[r];
+    }
+
+    std::vector<T> copy(begin, end);
+    parallelForRanges(n, n_ranges, [&](unsigned int r, size_t r_begin, size_t r_end)
+        {
+            size_t true_pos = true_offset[r];
+            size_t false_pos = false_offset[r];
+            for (size_t i = r_begin; i < r_end; i++)
+            {
+                begin[(is_true[i])? true_pos++ : false_pos++] = copy[i];
+            }
+        }, 1);
+    return begin + n_true;
+}
+
+//! Stable partition of [\p begin, \p end) on all hardware threads; see above.
+template<typename Iterator, typename Predicate>
+Iterator parallelStablePartition(Iterator begin, Iterator end, const Predicate& pred)
+{
+    return parallelStablePartition(begin, end, pred, getThreadCount());
+}
+
+#endif//PARALLEL_H
@@ -0,0 +1,112 @@
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+#include <stdint.h>
+#include <math.h> // fabs
+#include <limits> // epsilon
+
+#include "intpoint.h" // Point3
+
+/*!
+Exact orientation predicates on the integer coordinates of the mesh.
+
+Each predicate first evaluates its determinant in doubles, in which the coordinate differences are exact,
+and only returns that sign when it is larger than a bound on the rounding error (see Shewchuk - Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates).
+Otherwise the determinant is recomputed exactly in 128 bit integers.
+Coordinate differences fit in 33 bits, so the products of three of them never overflow.
+
+All predicates return 1, 0 or -1.
+*/
+
+#ifndef __SIZEOF_INT128__
+#   error "the exact fallback of the predicates needs a compiler which supports __int128"
+#endif
+
+/*!
+The plane through three points, for deciding exactly on which side of it other points lie.
+
+The cross product of the edges is computed once, so testing the three vertices of another triangle costs little more than three dot products.
+*/
+class Orient3dPlane
+{
+    Point3 origin; //!< a, the first point on the plane
+    int64_t ux, uy, uz; //!< b - a
+    int64_t vx, vy, vz; //!< c - a
+    double normal_x, normal_y, normal_z; //!< (b - a) x (c - a), rounded
+    double permanent_x, permanent_y, permanent_z; //!< the sums of the absolute products making up each coordinate of the normal
+public:
+    Orient3dPlane(const Point3& a, const Point3& b, const Point3& c)
+    : origin(a)
+    , ux(int64_t(b.x) - a.x), uy(int64_t(b.y) - a.y), uz(int64_t(b.z) - a.z)
+    , vx(int64_t(c.x) - a.x), vy(int64_t(c.y) - a.y), vz(int64_t(c.z) - a.z)
+    {
+        double uyvz = double(uy) * double(vz);
+        double uzvy = double(uz) * double(vy);
+        double uzvx = double(uz) * double(vx);
+        double uxvz = double(ux) * double(vz);
+        double uxvy = double(ux) * double(vy);
+        double uyvx = double(uy) * double(vx);
+        normal_x = uyvz - uzvy;
+        normal_y = uzvx - uxvz;
+        normal_z = uxvy - uyvx;
+        permanent_x = fabs(uyvz) + fabs(uzvy);
+        permanent_y = fabs(uzvx) + fabs(uxvz);
+        permanent_z = fabs(uxvy) + fabs(uyvx);
+    }
+
+    /*!
+    On which side of the plane \p d lies.
+    \return 1 when \p d lies on the side the normal (b - a) x (c - a) points to, -1 when on the other side and 0 when \p d lies exactly on the plane (or a, b and c are collinear)
+    */
+    int side(const Point3& d) const
+    {
+        double wx = double(d.x) - double(origin.x); // exact
+        double wy = double(d.y) - double(origin.y);
+        double wz = double(d.z) - double(origin.z);
+        double det = normal_x * wx + normal_y * wy + normal_z * wz;
+        double permanent = permanent_x * fabs(wx) + permanent_y * fabs(wy) + permanent_z * fabs(wz);
+        const double eps = std::numeric_limits<double>::epsilon() * .5;
+        double err_bound = (7. + 56. * eps) * eps * permanent;
+        if (det > err_bound) return 1;
+        if (-det > err_bound) return -1;
+        if (permanent == 0) return 0; // all products are exactly zero
+
+        __int128 exact = (__int128(uy) * vz - __int128(uz) * vy) * (int64_t(d.x) - origin.x)
+                       + (__int128(uz) * vx - __int128(ux) * vz) * (int64_t(d.y) - origin.y)
+                       + (__int128(ux) * vy - __int128(uy) * vx) * (int64_t(d.z) - origin.z);
+        return (exact > 0) - (exact < 0);
+    }
+};
+
+/*!
+On which side of the plane through \p a, \p b and \p c the point \p d lies.
+\return 1 when \p d lies on the side the normal (b - a) x (c - a) points to, -1 when on the other side and 0 when \p d lies exactly on the plane (or \p a, \p b and \p c are collinear)
+*/
+INLINE int orient3d(const Point3& a, const Point3& b, const Point3& c, const Point3& d)
+{
+    return Orient3dPlane(a, b, c).side(d);
+}
+
+/*!
+The orientation of the projection of \p a, \p b and \p c on the horizontal plane, i.e. the sign of the z of the normal (b - a) x (c - a).
+\return 1 when counterclockwise seen from above, -1 when clockwise and 0 when the projections are collinear
+*/
+INLINE int orient2d(const Point3& a, const Point3& b, const Point3& c)
+{
+    int64_t ux = int64_t(b.x) - a.x;
+    int64_t uy = int64_t(b.y) - a.y;
+    int64_t vx = int64_t(c.x) - a.x;
+    int64_t vy = int64_t(c.y) - a.y;
+    double uxvy = double(ux) * double(vy);
+    double uyvx = double(uy) * double(vx);
+    double det = uxvy - uyvx;
+    const double eps = std::numeric_limits<double>::epsilon() * .5;
+    double err_bound = (3. + 16. * eps) * eps * (fabs(uxvy) + fabs(uyvx));
+    if (det > err_bound) return 1;
+    if (-det > err_bound) return -1;
+
+    __int128 exact = __int128(ux) * vy - __int128(uy) * vx;
+    return (exact > 0) - (exact < 0);
+}
+
+#endif // PREDICATES_H
@@ -2,6 +2,9 @@
 #define STRING_H
 
 #include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h> // strtof
+#include <string.h> // memcpy
 
 //c++11 no longer supplies a strcasecmp, so define our own version.
 static inline int stringcasecompare(const char* a, const char* b)
@@ -16,4 +19,97 @@ static inline int stringcasecompare(const char* a, const char* b)
     return *a - *b;
 }
 
+/*!
+Parse a decimal floating point number starting at \p pos, reading no further than \p end.
+Leading spaces and tabs are skipped. On success \p pos is moved past the number.
+
+The common case (at most 19 significant digits and a small exponent) is converted without calling into libc.
+The result is always the same as what strtof would give: when the fast conversion can't guarantee correct rounding, the number is handed to strtof after all.
+
+\return whether a number was found
+*/
+static inline bool parseFloat(const char*& pos, const char* end, float& result)
+{
+    static const double powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* p = pos;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    const char* start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int n_digits = 0; // significant digits stored in mantissa
+    int exponent = 0;
+    bool exact = true; // whether all digits fitted in mantissa
+    bool has_digits = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        has_digits = true;
+        if (n_digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa > 0) n_digits++; }
+        else { exponent++; if (*p != '0') exact = false; }
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            has_digits = true;
+            if (n_digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa > 0) n_digits++; exponent--; }
+            else if (*p != '0') exact = false;
+        }
+    }
+    if (!has_digits)
+        exact = false; // maybe inf, nan or hexadecimal; leave those to strtof
+    if (exact && p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* e = p + 1;
+        bool exp_negative = false;
+        if (e < end && (*e == '-' || *e == '+'))
+        {
+            exp_negative = *e == '-';
+            e++;
+        }
+        if (e < end && *e >= '0' && *e <= '9')
+        {
+            int exp = 0;
+            for (; e < end && *e >= '0' && *e <= '9'; e++)
+                if (exp < 10000) exp = exp * 10 + (*e - '0');
+            exponent += exp_negative? -exp : exp;
+            p = e;
+        }
+    }
+    if (exact && (p >= end || isspace(static_cast<unsigned char>(*p))) && mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        // both the mantissa and the power of ten are exact doubles, so the division or multiplication is rounded correctly
+        double value = (exponent < 0)? double(mantissa) / powers_of_ten[-exponent] : double(mantissa) * powers_of_ten[exponent];
+        // rounding the double to a float only differs from rounding the exact value when the double lies exactly halfway between two floats
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        if (value == 0.0 || (bits & 0x1fffffffULL) != 0x10000000ULL)
+        {
+            result = float(negative? -value : value);
+            pos = p;
+            return true;
+        }
+    }
+
+    // slow path: let strtof handle it, on a null terminated copy since the input need not be terminated
+    char buffer[128];
+    size_t length = 0;
+    for (const char* c = start; c < end && !isspace(static_cast<unsigned char>(*c)) && length < sizeof(buffer) - 1; c++)
+        buffer[length++] = *c;
+    buffer[length] = '\0';
+    char* parse_end;
+    result = strtof(buffer, &parse_end);
+    if (parse_end == buffer)
+        return false;
+    pos = start + (parse_end - buffer);
+    return true;
+}
+
 #endif//STRING_H